@@ -30,6 +30,8 @@
 #include <seiscomp/autoloc/util.h>
 #include <seiscomp/autoloc/stationlocationfile.h>
 
+#include <algorithm>
+
 
 namespace Seiscomp {
 
@@ -40,6 +42,12 @@ namespace Applications {
 AutolocApp::AutolocApp(int argc, char **argv)
 	: Application(argc, argv), Autoloc::Autoloc3()
 	, objectCount(0)
+	, _batchSize(0)
+	, _rateWindowCount(0)
+	, _inputRate(0)
+	, _pipelined(false)
+	, _pipelineQueueSize(1000)
+	, _pipelineRunning(false)
 	, _inputPicks(nullptr)
 	, _inputAmps(nullptr)
 	, _inputOrgs(nullptr)
@@ -57,6 +65,13 @@ AutolocApp::AutolocApp(int argc, char **argv)
 	_wakeUpTimout = 5; // wake up every 5 seconds to check pending operations
 
 	_playbackSpeed = 1;
+
+	// The timeout is handled like the wakeup timer, which ends
+	// the batch, see handleTimeout().
+	_batchTimer.setSingleShot(true);
+	_batchTimer.setCallback([this]() {
+		sendNotification(Client::Notification::Timeout);
+	});
 }
 
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -225,6 +240,10 @@ void AutolocApp::createCommandLineDescription() {
 	commandline().addOption(
 		"Settings", "use-manual-origins",
 		"allow use of manual origins from our own agency");
+	commandline().addOption(
+		"Settings", "passive-manual-origins",
+		"process manual origins passively, i.e. only associate "
+		"picks without relocating");
 	commandline().addOption(
 		"Settings", "use-imported-origins",
 		"allow use of imported origins from trusted agencies as "
@@ -290,6 +309,9 @@ bool AutolocApp::validateParameters()
 	if ( commandline().hasOption("use-manual-origins") )
 		_config.useManualOrigins = true;
 
+	if ( commandline().hasOption("passive-manual-origins") )
+		_config.passiveManualOrigins = true;
+
 	if ( commandline().hasOption("use-imported-origins") )
 		_config.useImportedOrigins = true;
 
@@ -373,6 +395,17 @@ bool AutolocApp::initConfiguration()
 	}
 	catch (...) {}
 
+	try {
+		_config.cleanupStepSize =
+			configGetInt("buffer.cleanupStepSize");
+	}
+	catch (...) {}
+
+	try {
+		_config.scPickKeep = configGetDouble("buffer.scPickKeep");
+	}
+	catch (...) {}
+
 	try {
 		_config.defaultDepth =
 			configGetDouble("locator.defaultDepth");
@@ -561,6 +594,12 @@ bool AutolocApp::initConfiguration()
 	}
 	catch (...) {}
 
+	try {
+		_config.passiveManualOrigins =
+			configGetBool("autoloc.passiveManualOrigins");
+	}
+	catch (...) {}
+
 	try {
 		_config.useImportedOrigins =
 			configGetBool("autoloc.useImportedOrigins");
@@ -573,6 +612,114 @@ bool AutolocApp::initConfiguration()
 	}
 	catch (...) {}
 
+	try {
+		_config.associatorThreads =
+			configGetInt("autoloc.associatorThreads");
+	}
+	catch (...) {}
+
+	try {
+		_config.locatorPoolSize =
+			configGetInt("autoloc.locatorPoolSize");
+	}
+	catch (...) {}
+
+	try {
+		_config.relocationCacheSize =
+			configGetInt("autoloc.relocationCacheSize");
+	}
+	catch (...) {}
+
+	try {
+		_config.secondPassMaxShift =
+			configGetDouble("autoloc.secondPass.maxShift");
+	}
+	catch (...) {}
+
+	try {
+		_config.secondPassMaxTimeShift =
+			configGetDouble("autoloc.secondPass.maxTimeShift");
+	}
+	catch (...) {}
+
+	try {
+		_config.secondPassMaxRMSChange =
+			configGetDouble("autoloc.secondPass.maxRMSChange");
+	}
+	catch (...) {}
+
+	try {
+		_config.preLocatorMaxRMS =
+			configGetDouble("autoloc.preLocatorMaxRMS");
+	}
+	catch (...) {}
+
+	try {
+		_config.enhanceScoreMaxTrials =
+			configGetInt("autoloc.enhanceScore.maxTrials");
+	}
+	catch (...) {}
+
+	try {
+		_config.enhanceScoreTimeBudget =
+			configGetDouble("autoloc.enhanceScore.timeBudget");
+	}
+	catch (...) {}
+
+	try {
+		_config.depthScanDepths =
+			configGetDoubles("autoloc.depthScanDepths");
+	}
+	catch (...) {}
+
+	try {
+		_config.mergeEnable =
+			configGetBool("autoloc.merge.enable");
+	}
+	catch (...) {}
+
+	try {
+		_config.mergeMaxTimeDiff =
+			configGetDouble("autoloc.merge.maxTimeDifference");
+	}
+	catch (...) {}
+
+	try {
+		_config.mergeMaxDist =
+			configGetDouble("autoloc.merge.maxDistance");
+	}
+	catch (...) {}
+
+	try {
+		_config.batchMaxDelay =
+			configGetDouble("autoloc.batch.maxDelay");
+	}
+	catch (...) {}
+
+	try {
+		_config.batchMaxSize =
+			configGetInt("autoloc.batch.maxSize");
+	}
+	catch (...) {}
+
+	try {
+		_config.batchMinRate =
+			configGetDouble("autoloc.batch.minRate");
+	}
+	catch (...) {}
+
+	try {
+		_pipelined =
+			configGetBool("autoloc.pipeline.enable");
+	}
+	catch (...) {}
+
+	try {
+		_pipelineQueueSize =
+			configGetInt("autoloc.pipeline.queueSize");
+	}
+	catch (...) {}
+
 	try {
 		_wakeUpTimout =
 			configGetInt("autoloc.wakeupInterval");
@@ -1015,8 +1162,11 @@ bool AutolocApp::run()
 	}
 
 	// normal online mode
-	if ( ! Autoloc::Autoloc3::config().offline )
+	if ( ! Autoloc::Autoloc3::config().offline ) {
+		if (_pipelined && ! _config.playback)
+			_startPipeline();
 		return Application::run();
+	}
 
 	return true;
 }
@@ -1028,6 +1178,8 @@ bool AutolocApp::run()
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void AutolocApp::done() {
 	_exitRequested = true;
+	_stopPipeline();
+	_endBatchIfDue(true);
 	Autoloc::Autoloc3::shutdown();
 	Application::done();
 }
@@ -1042,6 +1194,12 @@ void AutolocApp::handleTimeout()
 	using namespace Seiscomp::DataModel;
 
 	if ( ! _config.playback || _inputFileXML.empty() ) {
+		if (_pipelineRunning) {
+			_releaseSent();
+			_logPipeline();
+		}
+
+		_endBatchIfDue(true);
 		report();
 		return;
 	}
@@ -1099,6 +1257,9 @@ void AutolocApp::handleTimeout()
 void AutolocApp::handleAutoShutdown()
 {
 	SEISCOMP_DEBUG("shutdown");
+	// send the queued origins first
+	_stopPipeline();
+	_endBatchIfDue(true);
 	Autoloc::Autoloc3::shutdown();
 	Seiscomp::Client::Application::handleAutoShutdown();
 }
@@ -1257,6 +1418,16 @@ static bool preliminary(const Seiscomp::DataModel::Origin *origin) {
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void AutolocApp::addObject(
 	const std::string& parentID, Seiscomp::DataModel::Object* o)
+{
+	processObject(o);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::processObject(Seiscomp::DataModel::Object* o)
 {
 	using namespace Seiscomp::DataModel;
 
@@ -1272,7 +1443,9 @@ void AutolocApp::addObject(
 	if (pick) {
 		sync(pick->creationInfo().creationTime());
 		logObject(_inputPicks, now());
+		_beginBatchIfBusy();
 		feed(pick);
+		_endBatchIfDue();
 		return;
 	}
 
@@ -1280,7 +1453,9 @@ void AutolocApp::addObject(
 	if (amplitude) {
 		sync(amplitude->creationInfo().creationTime());
 		logObject(_inputAmps, now());
+		_beginBatchIfBusy();
 		feed(amplitude);
+		_endBatchIfDue();
 		return;
 	}
 
@@ -1288,6 +1463,9 @@ void AutolocApp::addObject(
 	if (origin) {
 		sync(origin->creationInfo().creationTime());
 		logObject(_inputOrgs, now());
+		// Collected picks are processed before the origin to
+		// preserve the order of the input.
+		_endBatchIfDue(true);
 		feed(origin);
 		return;
 	}
@@ -1297,6 +1475,166 @@ void AutolocApp::addObject(
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::_beginBatchIfBusy()
+{
+	// Batching would make playback results depend on the
+	// playback speed.
+	if (_config.batchMaxDelay <= 0 || _config.playback)
+		return;
+
+	// input rate measured over windows of about one second
+	Core::Time t = Core::Time::GMT();
+	double dt = t - _rateWindowStart;
+	if (dt >= 1) {
+		_inputRate = _rateWindowCount/dt;
+		_rateWindowStart = t;
+		_rateWindowCount = 0;
+	}
+	_rateWindowCount++;
+
+	if (Autoloc::Autoloc3::isBatching()) {
+		_batchSize++;
+		return;
+	}
+
+	if (_inputRate < _config.batchMinRate &&
+	    _rateWindowCount < _config.batchMinRate)
+		return;
+
+	Autoloc::Autoloc3::beginBatch();
+	_batchStart = t;
+	_batchSize = 1;
+
+	// Without further objects the batch would otherwise only be
+	// ended by the wakeup timer.
+	double delay = _config.batchMaxDelay;
+	_batchTimer.setTimeout2(
+		(unsigned int)delay,
+		(unsigned int)((delay - (unsigned int)delay)*1E9));
+	_batchTimer.start();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::_endBatchIfDue(bool force)
+{
+	if ( ! Autoloc::Autoloc3::isBatching())
+		return;
+
+	if ( ! force) {
+		double dt = Core::Time::GMT() - _batchStart;
+		if (dt < _config.batchMaxDelay &&
+		    _batchSize < size_t(_config.batchMaxSize))
+			return;
+	}
+
+	_batchTimer.stop();
+
+	SEISCOMP_DEBUG(
+		"end of batch with %d objects", int(_batchSize));
+	_batchSize = 0;
+
+	if ( ! Autoloc::Autoloc3::endBatch())
+		return;
+
+	if ( _config.offline )
+		report();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::_startPipeline()
+{
+	size_t queueSize = std::max(1, _pipelineQueueSize);
+	_outputQueue.reset(new SPSCQueue<OutgoingOrigin*>(queueSize));
+	// The sent origins are released before each push to the output
+	// queue. Until then at most queueSize+1 origins come back, so the
+	// publishing thread never waits for the application thread.
+	_sentQueue.reset(new SPSCQueue<OutgoingOrigin*>(queueSize+1));
+
+	_publishingThread = std::thread([this]() { _publishingLoop(); });
+	_pipelineRunning = true;
+
+	SEISCOMP_INFO(
+		"pipelined mode with queue size %d", int(queueSize));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::_stopPipeline()
+{
+	if ( ! _pipelineRunning)
+		return;
+
+	// The publishing thread drains its queue before it stops.
+	_outputQueue->close();
+	_publishingThread.join();
+	_pipelineRunning = false;
+
+	_releaseSent();
+	_logPipeline();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::_publishingLoop()
+{
+	// Only plain pointers are passed, so that no reference count
+	// of an SC object is touched in this thread.
+	OutgoingOrigin *item;
+
+	while (_outputQueue->waitPop(item)) {
+		_send(*item);
+		_sentQueue->push(item);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::_releaseSent()
+{
+	OutgoingOrigin *item;
+
+	while (_sentQueue->pop(item))
+		delete item;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::_logPipeline() const
+{
+	if ( ! _outputQueue)
+		return;
+
+	SEISCOMP_DEBUG(
+		"PIPELINE output queue depth %d  max %d  origins %lu",
+		int(_outputQueue->depth()), int(_outputQueue->maxDepth()),
+		(unsigned long)_outputQueue->pushed());
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void logBlockedAgency(const Seiscomp::DataModel::Pick *scpick) {
 // TODO
@@ -1463,63 +1801,101 @@ bool AutolocApp::_report(Seiscomp::DataModel::Origin *scorigin)
 		return true;
 	}
 
-	EventParameters ep;
-	bool wasEnabled = Notifier::IsEnabled();
-	Notifier::Enable();
-	ep.add(scorigin);
-	Notifier::SetEnabled(wasEnabled);
-	NotifierMessagePtr nmsg = Notifier::GetMessage(true);
-	if (connection()->send(nmsg.get())) {
+	if (_pipelineRunning) {
+		// sent by the publishing thread
+		OutgoingOrigin *item = new OutgoingOrigin;
+		_prepare(scorigin, *item);
+		_releaseSent();
+		_outputQueue->push(item);
+		return true;
+	}
+
+	OutgoingOrigin item;
+	_prepare(scorigin, item);
+	return _send(item);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void AutolocApp::_prepare(
+	Seiscomp::DataModel::Origin *scorigin, OutgoingOrigin &item)
+{
+	using namespace Seiscomp::DataModel;
+
+	item.origin = scorigin;
+
+	// The notifier is created explicitly rather than via the global
+	// Notifier state.
+	item.message = new NotifierMessage;
+	item.message->attach(new Notifier(
+		EventParameters::ClassName(), OP_ADD, scorigin));
+
+	if ( ! preliminary(scorigin))
+		return;
+
+	// create the journal entry
+	std::string str;
+	try {
+		str = scorigin->evaluationStatus().toString();
+	}
+	catch ( Core::ValueException & ) {}
+
+	if ( str.empty() )
+		return;
+
+	JournalEntryPtr journalEntry = new JournalEntry;
+	journalEntry->setAction("OrgEvalStatOK");
+	journalEntry->setObjectID(scorigin->publicID());
+	journalEntry->setSender(SCCoreApp->author().c_str());
+	journalEntry->setParameters(str);
+	journalEntry->setCreated(Core::Time::GMT());
+
+	item.journal = new NotifierMessage;
+	item.journal->attach(new Notifier(
+		Journaling::ClassName(),
+		OP_ADD,
+		journalEntry.get()));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool AutolocApp::_send(const OutgoingOrigin &item)
+{
+	// Only reads the objects, which are owned by the application
+	// thread.
+	const char *publicID = item.origin->publicID().c_str();
+
+	if (connection()->send(item.message.get())) {
 		SEISCOMP_INFO(
 			"Origin %s sent to the message group: %s",
-			scorigin->publicID().c_str(),
-			primaryMessagingGroup().c_str());
+			publicID, primaryMessagingGroup().c_str());
 	}
 	else {
 		SEISCOMP_ERROR(
 			"Sending of origin %s failed with error: %s",
-			scorigin->publicID().c_str(),
-			connection()->lastError().toString());
+			publicID, connection()->lastError().toString());
 	}
 
-	if (preliminary(scorigin)) {
-		SEISCOMP_INFO(
-			"Sent preliminary origin %s (heads up)",
-			scorigin->publicID().c_str());
+	if ( ! item.journal)
+		return true;
 
-		// create and send journal entry
-		std::string str;
-		try {
-			str = scorigin->evaluationStatus().toString();
-		}
-		catch ( Core::ValueException & ) {}
-
-		if ( !str.empty() ) {
-			JournalEntryPtr journalEntry = new JournalEntry;
-			journalEntry->setAction("OrgEvalStatOK");
-			journalEntry->setObjectID(scorigin->publicID());
-			journalEntry->setSender(SCCoreApp->author().c_str());
-			journalEntry->setParameters(str);
-			journalEntry->setCreated(Core::Time::GMT());
-
-			NotifierMessagePtr jm = new NotifierMessage;
-			jm->attach(new Notifier(
-				Journaling::ClassName(),
-				OP_ADD,
-				journalEntry.get()));
-
-			if ( connection()->send(jm.get()) ) {
-				SEISCOMP_DEBUG(
-					"Sent origin journal entry for origin %s to the message group: %s",
-					scorigin->publicID().c_str(),
-					primaryMessagingGroup().c_str());
-			}
-			else {
-				SEISCOMP_ERROR(
-					"Sending of origin journal entry failed with error: %s",
-					connection()->lastError().toString());
-			}
-		}
+	SEISCOMP_INFO("Sent preliminary origin %s (heads up)", publicID);
+
+	if ( connection()->send(item.journal.get()) ) {
+		SEISCOMP_DEBUG(
+			"Sent origin journal entry for origin %s to the message group: %s",
+			publicID, primaryMessagingGroup().c_str());
+	}
+	else {
+		SEISCOMP_ERROR(
+			"Sending of origin journal entry failed with error: %s",
+			connection()->lastError().toString());
 	}
 
 	return true;
@@ -18,16 +18,23 @@
 #define SEISCOMP_APPLICATIONS_AUTOLOC_APP_H
 
 #include <queue>
+#include <memory>
+#include <thread>
+#include <atomic>
 #include <seiscomp/datamodel/pick.h>
 #include <seiscomp/datamodel/amplitude.h>
 #include <seiscomp/datamodel/origin.h>
 #include <seiscomp/datamodel/eventparameters.h>
 #include <seiscomp/datamodel/inventory.h>
+#include <seiscomp/datamodel/notifier.h>
 #include <seiscomp/client/application.h>
+#include <seiscomp/utils/timer.h>
 
 #include <seiscomp/autoloc/autoloc.h>
 #include <seiscomp/autoloc/objectqueue.h>
 
+#include "pipeline.h"
+
 
 namespace Seiscomp {
 
@@ -55,6 +62,21 @@ class PickAmplitudeSet {
 		Seiscomp::DataModel::AmplitudeCPtr amplitudeAbs;
 };
 
+
+// OutgoingOrigin
+//
+// An origin with the messages to send it. It is built and released in the
+// application thread. In pipelined mode, the publishing thread only sends
+// the messages and then hands the instance back.
+
+class OutgoingOrigin {
+	public:
+		Seiscomp::DataModel::OriginPtr origin;
+		Seiscomp::DataModel::NotifierMessagePtr message;
+		// the journal entry of a preliminary origin, if any
+		Seiscomp::DataModel::NotifierMessagePtr journal;
+};
+
 /*
 class PickAmplitudeBuffer {
 	PickAmplitudeBuffer(
@@ -106,6 +128,9 @@ class AutolocApp :
 			const std::string& parentID,
 			DataModel::Object*);
 
+		// Process an object received by addObject()
+		void processObject(DataModel::Object*);
+
 		// // These may be needed in future:
 		// void updateObject(
 		// 	const std::string& parentID,
@@ -119,6 +144,27 @@ class AutolocApp :
 
 		void handleTimeout();
 
+		// Micro-batching: Start collecting picks and amplitudes if
+		// the input rate is high and process the collected objects
+		// once the batch is full or old enough, or if forced.
+		void _beginBatchIfBusy();
+		void _endBatchIfDue(bool force=false);
+
+		// Pipelined mode: The origins are queued for the publishing
+		// thread, which returns them once sent. SC objects are only
+		// created and destroyed in the application thread, see
+		// SPSCQueue.
+		void _startPipeline();
+		void _stopPipeline();
+		void _publishingLoop();
+		// release the origins returned by the publishing thread
+		void _releaseSent();
+		void _logPipeline() const;
+
+		// Build the messages for an origin and send them
+		void _prepare(DataModel::Origin*, OutgoingOrigin&);
+		bool _send(const OutgoingOrigin&);
+
 	public:
 		virtual DataModel::Pick* loadPick(
 			const std::string &pickID);
@@ -150,6 +196,24 @@ class AutolocApp :
 		Core::Time syncTime;
 		unsigned int objectCount;
 
+		// micro-batching state
+		Core::Time _batchStart;
+		size_t _batchSize;
+		// one-shot, ends a batch if no further object arrives
+		Util::Timer _batchTimer;
+		Core::Time _rateWindowStart;
+		size_t _rateWindowCount;
+		double _inputRate;
+
+		// pipelined mode
+		bool _pipelined;
+		int _pipelineQueueSize;
+		bool _pipelineRunning;
+		// origins to the publishing thread and back
+		std::unique_ptr< SPSCQueue<OutgoingOrigin*> > _outputQueue;
+		std::unique_ptr< SPSCQueue<OutgoingOrigin*> > _sentQueue;
+		std::thread _publishingThread;
+
 		DataModel::EventParametersPtr ep;
 		DataModel::InventoryPtr inventory;
 
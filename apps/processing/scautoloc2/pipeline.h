@@ -0,0 +1,148 @@
+/***************************************************************************
+ * Copyright (C) GFZ Potsdam                                               *
+ * All rights reserved.                                                    *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ ***************************************************************************/
+
+
+
+
+#ifndef SEISCOMP_APPLICATIONS_AUTOLOC_PIPELINE_H
+#define SEISCOMP_APPLICATIONS_AUTOLOC_PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Seiscomp {
+
+namespace Applications {
+
+
+// Bounded lock-free queue for exactly one producer thread and one
+// consumer thread. Items are passed in order. push() waits while the
+// queue is full, which throttles the producer to the consumer.
+//
+// waitPop() blocks the consumer while the queue is empty. Only then a
+// mutex is involved; the producer just checks a flag after each push.
+//
+// Thread ownership: SeisComP datamodel objects are created and destroyed
+// only in the application thread, which owns the PublicObject registry.
+// Other threads may read them but must never hold the last reference.
+// Such objects are therefore not passed as smart pointers but in plain
+// instances which the consumer hands back through a second queue, to be
+// released by the application thread.
+template <typename T>
+class SPSCQueue {
+	public:
+		explicit SPSCQueue(size_t capacity=1000)
+			: _buffer(capacity+1), _head(0), _tail(0),
+			  _maxDepth(0), _pushed(0), _waiting(false), _closed(false) {}
+
+		// producer side
+		bool tryPush(const T &item) {
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			size_t next = (tail+1) % _buffer.size();
+			if (next == _head.load(std::memory_order_acquire))
+				return false;
+
+			_buffer[tail] = item;
+			_tail.store(next, std::memory_order_release);
+
+			size_t d = depth();
+			if (d > _maxDepth.load(std::memory_order_relaxed))
+				_maxDepth.store(d, std::memory_order_relaxed);
+			_pushed.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		void push(const T &item) {
+			while ( ! tryPush(item))
+				std::this_thread::yield();
+
+			// Pairs with the fence in waitPop(): either the
+			// consumer sees the item or we see it waiting.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (_waiting.load(std::memory_order_relaxed)) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_nonEmpty.notify_one();
+			}
+		}
+
+		// No more items will be pushed. Wakes up the consumer.
+		void close() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_closed = true;
+			}
+			_nonEmpty.notify_one();
+		}
+
+		// consumer side
+		bool pop(T &item) {
+			size_t head = _head.load(std::memory_order_relaxed);
+			if (head == _tail.load(std::memory_order_acquire))
+				return false;
+
+			item = _buffer[head];
+			// release our reference before handing the slot back
+			_buffer[head] = T();
+			_head.store((head+1) % _buffer.size(), std::memory_order_release);
+			return true;
+		}
+
+		// Waits for the next item. Returns false once the queue
+		// is closed and all items pushed before have been taken.
+		bool waitPop(T &item) {
+			while ( ! pop(item)) {
+				std::unique_lock<std::mutex> lock(_mutex);
+				if (_closed) {
+					lock.unlock();
+					return pop(item);
+				}
+
+				_waiting.store(true, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (depth() == 0)
+					_nonEmpty.wait(lock);
+				_waiting.store(false, std::memory_order_relaxed);
+			}
+			return true;
+		}
+
+		// metrics, may be read from any thread
+		size_t depth() const {
+			size_t head = _head.load(std::memory_order_acquire);
+			size_t tail = _tail.load(std::memory_order_acquire);
+			return (tail + _buffer.size() - head) % _buffer.size();
+		}
+		size_t maxDepth() const { return _maxDepth.load(std::memory_order_relaxed); }
+		size_t pushed() const { return _pushed.load(std::memory_order_relaxed); }
+
+	private:
+		std::vector<T> _buffer;
+		std::atomic<size_t> _head, _tail;
+		std::atomic<size_t> _maxDepth, _pushed;
+
+		std::mutex _mutex;
+		std::condition_variable _nonEmpty;
+		std::atomic<bool> _waiting;
+		bool _closed;
+};
+
+
+}  // namespace Applications
+
+}  // namespace Seiscomp
+
+#endif
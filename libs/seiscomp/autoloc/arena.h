@@ -0,0 +1,194 @@
+/***************************************************************************
+ * Copyright (C) GFZ Potsdam                                               *
+ * All rights reserved.                                                    *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_LIBAUTOLOC_ARENA_H_INCLUDED
+#define SEISCOMP_LIBAUTOLOC_ARENA_H_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace Seiscomp {
+
+namespace Autoloc {
+
+
+// Monotonic memory for transient containers that only live while one
+// pick (or group of picks) is processed. Allocation just advances a
+// pointer into a preallocated buffer and deallocation does nothing.
+// All memory is released at once at the end of the round, see Scope.
+//
+// If a round needs more than the buffer, the excess is taken from the
+// heap and the buffer is enlarged for the following rounds, up to
+// maxSize. Every shrinkRounds rounds, an enlarged buffer is shrunk
+// to what the largest of these rounds needed, but not below the
+// initial size, so that a single burst does not hold on to the
+// memory forever.
+//
+// Only for use by one thread. Objects that outlive the round must not
+// be allocated here; e.g. origins are always allocated on the heap.
+class Arena : public std::pmr::memory_resource {
+	public:
+		class Statistics {
+			public:
+				// finished rounds
+				size_t rounds{0};
+				// allocations served in all rounds and
+				// the maximum in one round
+				size_t allocations{0};
+				size_t maxAllocations{0};
+				size_t maxBytes{0};
+				// allocations that had to use the heap
+				size_t heapAllocations{0};
+				// current and largest buffer size
+				size_t bufferSize{0};
+				size_t maxBufferSize{0};
+		};
+
+		// Marks a processing round. The arena is reset when the
+		// outermost scope ends.
+		class Scope {
+			public:
+				Scope(Arena &arena) : _arena(arena) {
+					_arena._depth++;
+				}
+				~Scope() {
+					if (--_arena._depth == 0)
+						_arena.reset();
+				}
+			private:
+				Arena &_arena;
+		};
+
+	public:
+		explicit Arena(
+			size_t initialSize=1<<18,
+			size_t maxSize=1<<24,
+			size_t shrinkRounds=1000)
+			: _buffer(initialSize), _upstream(*this)
+			, _initialSize(initialSize), _maxSize(maxSize)
+			, _shrinkRounds(shrinkRounds) {
+			_createResource();
+			_statistics.bufferSize = _statistics.maxBufferSize =
+				_buffer.size();
+		}
+
+		void reset() {
+			Statistics &s = _statistics;
+			s.rounds++;
+			s.allocations += _allocations;
+			if (_allocations > s.maxAllocations)
+				s.maxAllocations = _allocations;
+			if (_bytes > s.maxBytes)
+				s.maxBytes = _bytes;
+
+			// Make room for a round like this one, or shrink
+			// if the recent rounds were much smaller
+			size_t size = _buffer.size();
+			if (_bytes > size)
+				size = std::max(size, std::min(2*_bytes, _maxSize));
+
+			_windowBytes = std::max(_windowBytes, _bytes);
+			if (++_windowRounds >= _shrinkRounds) {
+				size_t needed = std::max(_initialSize, 2*_windowBytes);
+				if (size > needed)
+					size = needed;
+				_windowRounds = _windowBytes = 0;
+			}
+
+			_resource.reset();
+			if (size != _buffer.size()) {
+				// not resize(), which would keep the capacity
+				_buffer = std::vector<char>(size);
+				s.bufferSize = size;
+				if (size > s.maxBufferSize)
+					s.maxBufferSize = size;
+			}
+			_createResource();
+
+			_allocations = _bytes = 0;
+		}
+
+		const Statistics &statistics() const { return _statistics; }
+
+	protected:
+		void *do_allocate(size_t bytes, size_t alignment) override {
+			_allocations++;
+			_bytes += bytes;
+			return _resource->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void*, size_t, size_t) override {}
+
+		bool do_is_equal(const std::pmr::memory_resource &other)
+			const noexcept override {
+			return this == &other;
+		}
+
+	private:
+		// The heap behind the buffer, counting its use
+		class Upstream : public std::pmr::memory_resource {
+			public:
+				Upstream(Arena &arena) : _arena(arena) {}
+
+			protected:
+				void *do_allocate(size_t bytes, size_t alignment) override {
+					_arena._statistics.heapAllocations++;
+					return std::pmr::new_delete_resource()
+						->allocate(bytes, alignment);
+				}
+
+				void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+					std::pmr::new_delete_resource()
+						->deallocate(p, bytes, alignment);
+				}
+
+				bool do_is_equal(const std::pmr::memory_resource &other)
+					const noexcept override {
+					return this == &other;
+				}
+
+			private:
+				Arena &_arena;
+		};
+
+		void _createResource() {
+			// Destroying the resource returns its heap memory
+			_resource.reset(new std::pmr::monotonic_buffer_resource(
+				_buffer.data(), _buffer.size(), &_upstream));
+		}
+
+	private:
+		std::vector<char> _buffer;
+		Upstream _upstream;
+		std::unique_ptr<std::pmr::monotonic_buffer_resource> _resource;
+
+		size_t _initialSize, _maxSize, _shrinkRounds;
+		// rounds since the last check for shrinking and the
+		// largest of them
+		size_t _windowRounds{0}, _windowBytes{0};
+
+		int _depth{0};
+		size_t _allocations{0}, _bytes{0};
+		Statistics _statistics;
+};
+
+
+}  // namespace Autoloc
+
+}  // namespace Seiscomp
+
+#endif
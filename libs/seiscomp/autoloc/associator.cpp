@@ -17,6 +17,7 @@
 #include <seiscomp/autoloc/associator.h>
 #include <seiscomp/autoloc/datamodel.h>
 #include <seiscomp/autoloc/util.h>
+#include <seiscomp/autoloc/parallel.h>
 
 #include <seiscomp/logging/log.h>
 
@@ -87,7 +88,7 @@ Associator::setStations(const Autoloc::DataModel::StationMap *stations)
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void
-Associator::setOrigins(const Autoloc::DataModel::OriginVector *origins)
+Associator::setOrigins(const Autoloc::DataModel::OriginRegistry *origins)
 {
 	_origins = origins;
 }
@@ -107,6 +108,23 @@ Associator::setPickPool(const Autoloc::DataModel::PickPool *p)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void
+Associator::setWorkerCount(size_t count)
+{
+	if (count < 1)
+		count = 1;
+	if (count == (_workers ? _workers->size() : 1))
+		return;
+
+	_workers.reset(count > 1 ? new Autoloc::WorkerPool(count) : nullptr);
+	_workerTTT.resize(count-1);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void
 Associator::reset()
@@ -128,6 +146,94 @@ Associator::shutdown()
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool Associator::_matchPick(
+	const Autoloc::DataModel::Origin *origin,
+	const Autoloc::DataModel::Pick *pick,
+	Seiscomp::TravelTimeTable &ttt,
+	PickMatch &match) const
+{
+	using namespace Autoloc;
+	using namespace Autoloc::DataModel;
+
+	const Station *station = pick->station();
+
+	double delta, az, baz;
+	delazi(origin, station, delta, az, baz);
+
+	// Weight residuals at regional distances "a bit" lower
+	// This is quite hackish!
+	double x = 1 + 0.6*exp(-0.003*delta*delta) +
+		       0.5*exp(-0.03*(15-delta)*(15-delta));
+
+	Seiscomp::TravelTimeList
+		*ttlist = ttt.compute(
+			origin->lat, origin->lon, origin->dep,
+			station->lat, station->lon, 0);
+
+	match.affinity = 0;
+
+	// For each pick in the pool we compute a travel time table.
+	// Then we try to match predicted and measured arrival times.
+	for (const Seiscomp::TravelTime &tt : *ttlist) {
+		// We skip this phase if we are out of the interesting
+		// range or if the phase was not found by inRange().
+		//
+		// This may well be within the defined phase range,
+		// but e.g. PcP gets so close to P at large distances
+		// that we cannot separate PcP from P.
+		if ( ! inRange(tt.phase, delta, origin->dep))
+			continue;
+
+		Time predicted = origin->time + tt.time;
+		double residual { pick->time - predicted };
+		double affinity { 0 };
+		double norm = 0.1; // TODO: review
+		double weighed_residual { residual/x * norm };
+
+		// TODO: REVIEW
+		// test if exp(-weighed_residual**2) if better
+		affinity = avgfn(weighed_residual);
+
+		std::string phase = tt.phase;
+		if (isP(phase))
+			// Generally we prefer generic name "P" over
+			// "Pg", "Pn", "Pb", "Pdiff" et al. but
+			// TODO:  need to take care of picks with
+			// non-generic phase label, although in the
+			// context of this function that should be no
+			// real issue.
+			phase = "P";
+
+		// certain phases have lower probability because they
+		// have smaller amplitude or immediately follow an
+		// arrival with usually larger amplitude. This is an
+		// attempt to deal with that but this is experimental.
+		double phaseWeight { 1. };
+		if (phase == "PKPab" || phase == "PKPdf")
+			phaseWeight = 0.5;
+		affinity *= phaseWeight;
+
+		if (affinity < minimumAffinity)
+			continue;
+		if (affinity > match.affinity) {
+			match.phase = phase;
+			match.residual = residual;
+			match.affinity = affinity;
+			match.distance = delta;
+			match.azimuth = az;
+		}
+	}
+
+	delete ttlist;
+
+	return match.affinity > 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool Associator::findMatchingPicks(
 	const Autoloc::DataModel::Origin *origin,
@@ -140,9 +246,17 @@ bool Associator::findMatchingPicks(
 		associateDisabledStationsToQualifiedOrigin &&
 		(imported(origin) || manual(origin));
 
-	for (auto &item: *pickPool) {
+	// First collect the candidate picks. This is cheap and done
+	// serially, also because of the logging.
+	std::vector<const Pick*> candidates;
+
+	for (const PickCPtr &item: *pickPool) {
 
-		const Pick *pick = item.second.get();
+		const Pick *pick = item.get();
+
+		// released SC pick, would fail in the locator
+		if ( ! pick->scpick)
+			continue;
 
 //SEISCOMP_ERROR_S("findMatchingPicks A  " + pick->id());
 		if (pick->time < origin->time)
@@ -203,78 +317,45 @@ bool Associator::findMatchingPicks(
 		if ( ! station->enabled && ! considerDisabledStations)
 			continue;
 
-		double delta, az, baz;
-		delazi(origin, station, delta, az, baz);
-
-		// Weight residuals at regional distances "a bit" lower
-		// This is quite hackish!
-		double x = 1 + 0.6*exp(-0.003*delta*delta) +
-			       0.5*exp(-0.03*(15-delta)*(15-delta));
-
-		Seiscomp::TravelTimeList
-			*ttlist = ttt.compute(
-				origin->lat, origin->lon, origin->dep,
-				station->lat, station->lon, 0);
-
-		Association best;
-		best.affinity = 0;
-
-		// For each pick in the pool we compute a travel time table.
-		// Then we try to match predicted and measured arrival times.
-		for (const Seiscomp::TravelTime &tt : *ttlist) {
-			// We skip this phase if we are out of the interesting
-			// range or if the phase was not found by inRange().
-			//
-			// This may well be within the defined phase range,
-			// but e.g. PcP gets so close to P at large distances
-			// that we cannot separate PcP from P.
-			if ( ! inRange(tt.phase, delta, origin->dep))
-				continue;
+		candidates.push_back(pick);
+	}
 
-			Time predicted = origin->time + tt.time;
-			double residual { pick->time - predicted };
-			double affinity { 0 };
-			double norm = 0.1; // TODO: review
-			double weighed_residual { residual/x * norm };
-
-			// TODO: REVIEW
-			// test if exp(-weighed_residual**2) if better
-			affinity = avgfn(weighed_residual);
-
-			std::string phase = tt.phase;
-			if (isP(phase))
-				// Generally we prefer generic name "P" over
-				// "Pg", "Pn", "Pb", "Pdiff" et al. but
-				// TODO:  need to take care of picks with
-				// non-generic phase label, although in the
-				// context of this function that should be no
-				// real issue.
-				phase = "P";
-
-			// certain phases have lower probability because they
-			// have smaller amplitude or immediately follow an
-			// arrival with usually larger amplitude. This is an
-			// attempt to deal with that but this is experimental.
-			double phaseWeight { 1. };
-			if (phase == "PKPab" || phase == "PKPdf")
-				phaseWeight = 0.5;
-			affinity *= phaseWeight;
+	// The expensive part: distance and travel-time computation for
+	// each candidate. The candidates are independent of each other,
+	// so with more than one worker they are processed in shards,
+	// each worker using its own travel-time table. Very few
+	// candidates are not worth waking up the workers.
+	std::vector<PickMatch> matches(candidates.size());
+	std::vector<char> matched(candidates.size(), 0);
+
+	auto match = [&](size_t worker, size_t i) {
+		Seiscomp::TravelTimeTable &t =
+			worker ? _workerTTT[worker-1] : ttt;
+		matched[i] = _matchPick(
+			origin, candidates[i], t, matches[i]);
+	};
+
+	if (_workers && candidates.size() >= 50)
+		_workers->run(candidates.size(), match);
+	else {
+		for (size_t i=0; i<candidates.size(); i++)
+			match(0, i);
+	}
 
-			if (affinity < minimumAffinity)
-				continue;
-			Association asso(
-				origin, pick, phase,
-				residual, affinity);
-			asso.distance = delta;
-			asso.azimuth = az;
-			asso.excluded = Arrival::NotExcluded;
-			if (asso.affinity > best.affinity)
-				best = asso;
-		}
-		if (best.affinity > 0)
-			associations.push_back(best);
+	// Merge in the order of the pick pool, independent of the
+	// number of workers.
+	for (size_t i=0; i<candidates.size(); i++) {
+		if ( ! matched[i])
+			continue;
 
-		delete ttlist;
+		const PickMatch &m = matches[i];
+		Association asso(
+			origin, candidates[i], m.phase,
+			m.residual, m.affinity);
+		asso.distance = m.distance;
+		asso.azimuth = m.azimuth;
+		asso.excluded = Arrival::NotExcluded;
+		associations.push_back(asso);
 	}
 
 	return true;
@@ -15,11 +15,17 @@
 #ifndef SEISCOMP_LIBAUTOLOC_ASSOCIATOR_H_INCLUDED
 #define SEISCOMP_LIBAUTOLOC_ASSOCIATOR_H_INCLUDED
 
+#include <memory>
+
 #include <seiscomp/seismology/ttt.h>
 #include <seiscomp/autoloc/datamodel.h>
 
 namespace Seiscomp {
 
+namespace Autoloc {
+class WorkerPool;
+}
+
 
 typedef Autoloc::DataModel::Arrival Association;
 
@@ -57,9 +63,15 @@ class Associator
 
 	public:
 		void setStations(const Autoloc::DataModel::StationMap *stations);
-		void setOrigins(const Autoloc::DataModel::OriginVector *origins);
+		void setOrigins(const Autoloc::DataModel::OriginRegistry *origins);
 		void setPickPool(const Autoloc::DataModel::PickPool*);
 
+		// Number of threads used in findMatchingPicks(). Default
+		// is 1, i.e. no threads are used. The threads are kept
+		// until the count changes. Note that a count > 1
+		// requires the travel-time code to be thread-safe.
+		void setWorkerCount(size_t count);
+
 	public:
 		// Get a rough idea if the pick *might* be assiciated to
 		// the origin.
@@ -113,6 +125,23 @@ class Associator
 		bool inRange(
 			const std::string &code,
 			double delta, double depth) const;
+
+		// Result of matching one pick against an origin in
+		// findMatchingPicks(). Intentionally free of smart
+		// pointers so that it can be computed in a worker thread.
+		struct PickMatch {
+			std::string phase;
+			double residual{0}, affinity{0};
+			double distance{0}, azimuth{0};
+		};
+
+		// Find the best-matching phase for the pick. Returns
+		// false if there is no phase with sufficient affinity.
+		bool _matchPick(
+			const Autoloc::DataModel::Origin *origin,
+			const Autoloc::DataModel::Pick *pick,
+			Seiscomp::TravelTimeTable &ttt,
+			PickMatch &match) const;
 	public:
 		void reset();
 		void shutdown();
@@ -120,7 +149,7 @@ class Associator
 	protected:
 		// these are not owned:
 		const Autoloc::DataModel::StationMap *_stations;
-		const Autoloc::DataModel::OriginVector *_origins;
+		const Autoloc::DataModel::OriginRegistry *_origins;
 		const Autoloc::DataModel::PickPool *pickPool;
 
 	private:
@@ -131,6 +160,11 @@ class Associator
 	private:
 		PhaseRangeVector _phaseRanges;
 		mutable Seiscomp::TravelTimeTable ttt;
+
+		// the worker threads, if more than one worker, and one
+		// travel-time table per additional worker
+		std::unique_ptr<Autoloc::WorkerPool> _workers;
+		mutable std::vector<Seiscomp::TravelTimeTable> _workerTTT;
 };
 
 
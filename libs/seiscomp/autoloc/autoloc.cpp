@@ -40,6 +40,7 @@
 #include <seiscomp/datamodel/station.h>
 
 #include <algorithm>
+#include <chrono>
 
 namespace Seiscomp {
 
@@ -54,6 +55,7 @@ Autoloc3::Autoloc3()
 	_relocator.setMinimumDepth(_config.minimumDepth);
 	scconfig = nullptr;
 	processingEnabled = true;
+	_batching = false;
 
 	// TODO/FIXME: Important config option
 	associateDisabledStationsToQualifiedOrigin = true;
@@ -86,7 +88,19 @@ bool Autoloc3::init()
 			return false;
 	}
 
+	SecondPassTolerances secondPassTolerances;
+	secondPassTolerances.maxShift = _config.secondPassMaxShift;
+	secondPassTolerances.maxTimeShift = _config.secondPassMaxTimeShift;
+	secondPassTolerances.maxRMSChange = _config.secondPassMaxRMSChange;
+
 	_nucleator.setConfig(scconfig);
+	GridSearchConfig gridSearchConfig = _nucleator.config();
+	gridSearchConfig.locatorPoolSize = _config.locatorPoolSize;
+	gridSearchConfig.relocationCacheSize = _config.relocationCacheSize;
+	gridSearchConfig.secondPassTolerances = secondPassTolerances;
+	gridSearchConfig.preLocatorMaxRMS = _config.preLocatorMaxRMS;
+	_nucleator.setConfig(gridSearchConfig);
+	_nucleator.setArena(&_arena);
 	if ( ! _nucleator.setGridFilename(_config.gridConfigFile))
 		return false;
 	if ( ! _nucleator.init())
@@ -97,6 +111,17 @@ bool Autoloc3::init()
 		return false;
 
 	_relocator.setMinimumDepth(_config.minimumDepth);
+	_relocator.setCacheSize(_config.relocationCacheSize);
+	_relocator.setSecondPassTolerances(secondPassTolerances);
+
+	_relocatorPool.setConfig(scconfig);
+	if ( ! _relocatorPool.init(_config.locatorPoolSize))
+		return false;
+	_relocatorPool.setMinimumDepth(_config.minimumDepth);
+	_relocatorPool.setCacheSize(_config.relocationCacheSize);
+	_relocatorPool.setSecondPassTolerances(secondPassTolerances);
+
+	_associator.setWorkerCount(_config.associatorThreads);
 
 	setLocatorProfile(_config.locatorProfile);
 
@@ -164,13 +189,7 @@ Autoloc3::pickFromPool(const std::string &id) const
 {
 	using namespace Autoloc::DataModel;
 
-	PickPool::const_iterator it = pickPool.find(id);
-	if (it == pickPool.end())
-		return nullptr;
-
-	const Pick* pick = it->second.get();
-
-	return pick;
+	return pickPool.get(id);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -192,7 +211,10 @@ Autoloc3::now()
 bool Autoloc3::storeInPool(const Autoloc::DataModel::Pick *pick)
 {
 	if ( ! pickFromPool(pick->id())) {
-		pickPool[ pick->id() ] = pick;
+		pickPool.insert(pick);
+		_pickExpiry.push(pick->time, pick);
+		if (_config.scPickKeep > 0)
+			_scPickExpiry.push(pick->time, pick);
 SEISCOMP_DEBUG_S("Autoloc3::storeInPool "+pick->id());
 		return true;
 	}
@@ -417,11 +439,51 @@ bool Autoloc3::isProcessingEnabled() const
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
+void Autoloc3::beginBatch()
 {
-	_newOrigins.clear();
+	_batching = true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
 
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool Autoloc3::endBatch()
+{
+	_batching = false;
+
+	Autoloc::DataModel::PickGroup group;
+	group.swap(_batch);
+	if (group.empty())
+		return false;
+
+	SEISCOMP_DEBUG("processing batch of %d picks", int(group.size()));
+	return feed(group);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
+{
 	using namespace Autoloc::DataModel;
+
+	if (_batching) {
+		// Only store the pick now. It is processed in endBatch()
+		// once, even if its amplitudes are fed later.
+		storeInPool(pick);
+		const Pick *p = pickFromPool(pick->id());
+		if (std::find(_batch.begin(), _batch.end(), p) == _batch.end())
+			_batch.push_back(p);
+		return false;
+	}
+
+	Autoloc::Arena::Scope arenaScope(_arena);
+
+	_newOrigins.clear();
 /*
 	TODO!
 	if (_expired(pick)) {
@@ -439,6 +501,191 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 
 	bool isnew = storeInPool(pick);
 
+	const Pick *p = _preparePick(pick, isnew);
+	if ( ! p)
+		return false;
+
+	bool result = _process(p);
+	if ( ! result)
+		return false;
+
+	_mergeEquivalentOrigins();
+	report();
+	cleanup();
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool Autoloc3::feed(const Autoloc::DataModel::PickGroup &group)
+{
+	Autoloc::Arena::Scope arenaScope(_arena);
+
+	_newOrigins.clear();
+
+	using namespace Autoloc::DataModel;
+
+	// Store all picks first so that each of them can be seen while
+	// processing any other pick of the group.
+	std::vector<bool> isnew;
+	for (const Pick *pick: group)
+		isnew.push_back(storeInPool(pick));
+
+	std::vector<const Pick*> picks;
+	for (size_t i=0; i<group.size(); i++) {
+		const Pick *p = _preparePick(group[i], isnew[i]);
+		if (p)
+			picks.push_back(p);
+	}
+
+	std::stable_sort(picks.begin(), picks.end(),
+		[](const Pick *a, const Pick *b) { return a->time < b->time; });
+
+	bool result = false;
+
+	// Associate all picks to existing origins. The updated origins
+	// are collected by ID. Later picks are associated to a copy of
+	// the working copy, which then replaces it.
+	std::map<OriginID, OriginPtr> affected;
+	std::vector<const Pick*> processed;
+	_workingOrigins = &affected;
+	for (const Pick *pick: picks) {
+		bool accepted = false;
+		if ( ! _screen(pick, accepted)) {
+			result = result || accepted;
+			continue;
+		}
+
+		SEISCOMP_INFO(
+			"process pick %-35s %s  (group)",
+			pick->id().c_str(), (pick->xxl ? " XXL" : ""));
+		processed.push_back(pick);
+
+		OriginPtr origin = _trySupersede(pick);
+		if ( ! origin)
+			origin = _tryAssociate(pick);
+		if ( ! origin)
+			continue;
+
+		affected[origin->id] = origin;
+	}
+	_workingOrigins = nullptr;
+
+	// Rework each affected origin only once.
+	std::set<OriginID> bypass;
+	for (auto &item: affected) {
+		Origin *origin = item.second.get();
+
+		if ( ! imported(origin) && ! origin->locked) {
+			_rework(origin);
+			if ( ! _passedFilter(origin))
+				continue;
+		}
+
+		_store(origin);
+		result = true;
+
+		if (imported(origin) || origin->locked ||
+		    origin->score >= _config.minScoreBypassNucleator)
+			bypass.insert(origin->id);
+	}
+
+	// One nucleation pass over all picks not associated to an origin
+	// that bypasses the nucleator. As in _process(), picks associated
+	// to a stored origin are fed but don't contribute candidates.
+	OriginVector candidates;
+	std::vector<const Pick*> unassociated;
+	for (const Pick *pick: processed) {
+		OriginID id = pick->originID();
+		if (id && bypass.count(id))
+			continue;
+
+		bool stored = id && _origins.find(id);
+		if ( ! _nucleator.feed(pick) || stored)
+			continue;
+
+		for (const OriginPtr &candidate: _nucleator.newOrigins())
+			candidates.push_back(candidate);
+		unassociated.push_back(pick);
+	}
+
+	// Store each new origin that passes the filter, best first. The
+	// candidates sharing picks with an origin tried before are
+	// dropped, so a burst covering several events yields an origin
+	// for each of them.
+	std::set<const Pick*> used;
+	while ( ! candidates.empty()) {
+		OriginPtr origin = _bestCandidate(candidates);
+		if ( ! origin)
+			break;
+
+		_rework(origin.get());
+		if (_passedFilter(origin.get())) {
+			_store(origin.get());
+			result = true;
+		}
+
+		const Origin *tried = origin.get();
+		for (const Arrival &arr: tried->arrivals)
+			used.insert(arr.pick.get());
+
+		size_t count = candidates.size();
+		candidates.erase(
+			std::remove_if(candidates.begin(), candidates.end(),
+				[&used](const OriginPtr &item) {
+					const Origin *candidate = item.get();
+					for (const Arrival &arr: candidate->arrivals) {
+						if (used.count(arr.pick.get()))
+							return true;
+					}
+					return false;
+				}),
+			candidates.end());
+		if (candidates.size() == count)
+			break;
+	}
+
+	// Finally try the XXL feature for the remaining picks.
+	for (const Pick *pick: unassociated) {
+		if (pick->originID())
+			continue;
+
+		OriginPtr origin = _tryXXL(pick);
+		if ( ! origin)
+			continue;
+
+		_rework(origin.get());
+		if (_passedFilter(origin.get())) {
+			_store(origin.get());
+			result = true;
+			break;
+		}
+	}
+
+	if ( ! result)
+		return false;
+
+	_mergeEquivalentOrigins();
+	report();
+	cleanup();
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const Autoloc::DataModel::Pick*
+Autoloc3::_preparePick(const Autoloc::DataModel::Pick *pick, bool isnew)
+{
+	using namespace Autoloc::DataModel;
+
 	if ( ! processingEnabled) {
 		SEISCOMP_INFO(
 			"process pick %-35s %c   "
@@ -446,7 +693,7 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 			pick->id().c_str(), statusFlag(pick));
 
 		// Note that pick has been stored in pick pool!	
-		return false;
+		return nullptr;
 	}
 
 	// An associated manual pick is always processed, even from a
@@ -459,7 +706,7 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 			pick->id().c_str());
 
 		// Note that pick has been stored in pick pool!	
-		return false;
+		return nullptr;
 	}
 
 	if (pick->priority <= 0) {
@@ -468,7 +715,7 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 			pick->id().c_str());
 
 		// Note that pick has been stored in pick pool!	
-		return false;
+		return nullptr;
 	}
 
 	if (_requiresAmplitude(pick)) {
@@ -479,7 +726,7 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 				SEISCOMP_DEBUG(
 					"process pick %-35s %c   waiting for amplitude",
 					pick->id().c_str(), statusFlag(pick));
-			return false;
+			return nullptr;
 		}
 	}
 	else {
@@ -500,9 +747,9 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 	// duplicate picks at almost exactly the same time. We don't want such
 	// duplicates to spoil our solutions so we detect this situation here
 	// and mark duplicate picks as blacklisted
-	for (const auto &item: pickPool) {
+	for (const PickCPtr &item: pickPool) {
 
-		const Pick *existingPick = item.second.get();
+		const Pick *existingPick = item.get();
 
 		if (existingPick->station() != pick->station())
 			continue;
@@ -522,7 +769,7 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 
 	const Pick *p = pickFromPool(pick->id());
 	if (p->blacklisted)
-		return false;
+		return nullptr;
 
 
 	// A pick is tagged as XXL pick if it exceeds BOTH the configured XXL
@@ -530,8 +777,11 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 	if ( _config.xxlEnabled &&
 	     p->amp >= _config.xxlMinAmplitude &&
 	     p->snr >  _config.xxlMinSNR ) {
-		SEISCOMP_DEBUG_S("XXL pick " + p->scpick->publicID());
-		const_cast<Pick*>(p)->xxl = true;
+		SEISCOMP_DEBUG_S("XXL pick " + p->id());
+		if ( ! p->xxl) {
+			const_cast<Pick*>(p)->xxl = true;
+			_xxlAddPick(p);
+		}
 	}
 
 	// arbitrary choice
@@ -541,15 +791,7 @@ bool Autoloc3::feed(const Autoloc::DataModel::Pick *pick)
 		normalizationAmplitude = _config.xxlMinAmplitude;
 	const_cast<Pick*>(p)->normamp = p->amp/normalizationAmplitude;
 
-
-	bool result = _process(p);
-	if ( ! result)
-		return false;
-
-	report();
-	cleanup();
-
-	return true;
+	return p;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -587,7 +829,7 @@ Autoloc3::_findMatchingOrigin(const Autoloc::DataModel::Origin *origin) const
 		size_t identical=0, similar=0;
 
 		// look for manual picks associated to this origin
-		for (auto arr: existing->arrivals) {
+		for (const auto &arr: existing->arrivals) {
 			const Pick *pick = arr.pick.get();
 
 			if ( ! pick->station()) {
@@ -598,7 +840,7 @@ Autoloc3::_findMatchingOrigin(const Autoloc::DataModel::Origin *origin) const
 			}
 
 			// try to find a matching pick in our newly fed origin
-			for (auto arr2: origin->arrivals) {
+			for (const auto &arr2: origin->arrivals) {
 				const Pick *pick2 = arr2.pick.get();
 
 				// TODO: adopt arrival weight etc.
@@ -756,8 +998,8 @@ bool Autoloc3::_tooManyRecentPicks(const Autoloc::DataModel::Pick *newPick) cons
 		return true;
 	}
 */
-	for (const auto &item: pickPool) {
-		const Pick *previousPick = item.second.get();
+	for (const PickCPtr &item: pickPool) {
+		const Pick *previousPick = item.get();
 
 		if (previousPick->station() != newPick->station())
 			continue;
@@ -817,6 +1059,8 @@ Autoloc3::merge(
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::Merge);
+
 	// The second origin is merged into the first. A new instance
 	// is returned that has the ID of the first.
 	OriginID id = origin1->id;
@@ -884,11 +1128,13 @@ Autoloc3::merge(
 
 	// now see which of the temporarily excluded new arrivals have
 	// acceptable residuals
-	for (auto &a : combined->arrivals) {
+	for (size_t i=0; i<combined->arrivals.size(); i++) {
+		const Arrival &a = combined->arrivals[i];
 		if (a.excluded == Arrival::TemporarilyExcluded)
-			a.excluded = _residualWithinAllowedRange(a, 1.3, 1.8)
+			combined->arrivals.setExcluded(i,
+				_residualWithinAllowedRange(a, 1.3, 1.8)
 				? Arrival::NotExcluded
-				: Arrival::LargeResidual;
+				: Arrival::LargeResidual);
 	}
 
 	_trimResiduals(combined);
@@ -900,24 +1146,127 @@ Autoloc3::merge(
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int Autoloc3::_mergeEquivalentOrigins()
+{
+	using namespace Autoloc::DataModel;
+
+	if ( ! _config.mergeEnable)
+		return 0;
+
+	auto mergeable = [](const Origin *origin) {
+		return ! imported(origin) && ! manual(origin) && ! origin->locked;
+	};
+
+	auto published = [this](OriginID id) {
+		const OriginRegistry::Record *rec = _origins.record(id);
+		return rec && rec->lastSent;
+	};
+
+	// origins merged during this call
+	std::set<OriginID> merged;
+	int mergeCount = 0;
+
+	// _store() may append to _newOrigins
+	OriginVector updated = _newOrigins;
+	for (const OriginPtr &origin : updated) {
+		if (merged.count(origin->id) || ! mergeable(origin.get()))
+			continue;
+
+		std::vector<OriginID> ids = _origins.equivalentOrigins(
+			origin.get(), _config.mergeMaxTimeDiff, _config.mergeMaxDist);
+
+		for (OriginID id : ids) {
+			if (merged.count(id))
+				continue;
+
+			OriginPtr other = _origins.find(id);
+			if ( ! other || ! mergeable(other.get()))
+				continue;
+
+			// The published origin is kept, or the older one if
+			// both or none have been published. If both have
+			// been published, the last published version of the
+			// absorbed origin is not withdrawn. It remains as is
+			// downstream, where it is usually associated to the
+			// same event as the kept origin.
+			OriginPtr kept = origin, absorbed = other;
+			if (absorbed->id < kept->id)
+				std::swap(kept, absorbed);
+			if ( ! published(kept->id) && published(absorbed->id))
+				std::swap(kept, absorbed);
+
+			OriginPtr temp = merge(kept.get(), absorbed.get());
+			if ( ! temp)
+				continue;
+
+			double score = _score(temp.get());
+			if (score < _score(kept.get()) ||
+			    score < _score(absorbed.get()))
+				continue;
+			if ( ! _passedFilter(temp.get()))
+				continue;
+
+			SEISCOMP_INFO(
+				" MRG origin %ld merged into %ld",
+				absorbed->id, kept->id);
+
+			_store(temp.get());
+
+			// The picks of the absorbed origin now belong to
+			// the merged origin or to no origin.
+			const Origin *stored = _origins.find(kept->id);
+			for (const Arrival &arr : stored->arrivals) {
+				if ( ! arr.excluded &&
+				     arr.pick->originID() == absorbed->id)
+					stored->adopt(arr.pick.get());
+			}
+			for (const Arrival &arr : absorbed->arrivals) {
+				if (arr.pick->originID() == absorbed->id)
+					arr.pick->setOriginID(0);
+			}
+
+			_origins.remove(std::vector<OriginID>{absorbed->id});
+			_newOrigins.erase(
+				std::remove(_newOrigins.begin(), _newOrigins.end(), absorbed),
+				_newOrigins.end());
+
+			merged.insert(kept->id);
+			merged.insert(absorbed->id);
+			mergeCount++;
+			break;
+		}
+	}
+
+	return mergeCount;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool Autoloc3::_followsBiggerPick(
 	const Autoloc::DataModel::Pick *newPick) const
 {
 	using namespace Autoloc::DataModel;
 
+	Station::Handle h = newPick->station()->handle;
+	if (h >= _xxlPicks.size())
+		return false;
+
 	// Check whether this pick is within a short time
 	// after an XXL pick from the same station
-	for (const auto &item: pickPool) {
-		const Pick *pick = item.second.get();
+	for (const PickCPtr &item: _xxlPicks[h]) {
+		const Pick *pick = item.get();
 
 		if (pick == newPick)
 			continue;
 
-		if ( ! pick->xxl)
+		if (pick->station() != newPick->station())
 			continue;
 
-		if (pick->station() != newPick->station())
+		if (pickFromPool(pick->id()) != pick)
 			continue;
 
 		double dt = newPick->time - pick->time;
@@ -1001,6 +1350,8 @@ Autoloc3::_xxlPreliminaryOrigin(const Autoloc::DataModel::Pick *newPick)
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::XXL);
+
 	if ( ! newPick->xxl)
 		// nothing else to do for this pick
 		return 0;
@@ -1010,46 +1361,43 @@ Autoloc3::_xxlPreliminaryOrigin(const Autoloc::DataModel::Pick *newPick)
 	std::vector<const Pick*> xxlpicks;
 	const Pick *earliest = newPick;
 	xxlpicks.push_back(newPick);
-	for (const auto &item: pickPool) {
-		const Pick *pick = item.second.get();
 
-		if ( ! pick->xxl )
-			continue;
+	// Only the recent XXL picks of the stations within
+	// xxlMaxStaDist are candidates.
+	Station::Handle h = newPick->station()->handle;
+	if (h < _xxlNeighbours.size()) {
+		for (Station::Handle neighbour: _xxlNeighbours[h]) {
+			for (const PickCPtr &item: _xxlPicks[neighbour]) {
+				const Pick *pick = item.get();
 
-		if ( ignored(pick) )
-			continue;
-				
-		if ( newPick->station() == pick->station() )
-			continue;
+				if ( ignored(pick) )
+					continue;
 
-		double dt = newPick->time - pick->time;
-		double dx = distance(pick->station(), newPick->station());
+				// released SC pick, would fail in the locator
+				if ( ! pick->scpick)
+					continue;
 
-		if (std::abs(dt) > 10+13.7*_config.xxlMaxStaDist)
-			continue;
+				double dt = newPick->time - pick->time;
+				if (std::abs(dt) > 10+13.7*_config.xxlMaxStaDist)
+					continue;
 
-		if ( dx > _config.xxlMaxStaDist )
-			continue;
+				if ( ! _config.useManualPicks && manual(pick) &&
+				     ! _config.useManualOrigins )
+					continue;
 
-		if ( ! _config.useManualPicks && manual(pick) &&
-		     ! _config.useManualOrigins )
-			continue;
+				if (pickFromPool(pick->id()) != pick)
+					continue;
 
-		// make sure we don't have two picks of the same station
-		bool duplicate_station = false;
-		for (const Pick* pick: xxlpicks) {
-			if (pick->station() == pick->station()) {
-				duplicate_station = true;
+				xxlpicks.push_back(pick);
+
+				if ( pick->time < earliest->time )
+					earliest = pick;
+
+				// make sure we don't have two picks of the
+				// same station
 				break;
 			}
 		}
-		if ( duplicate_station )
-			continue;
-
-		xxlpicks.push_back(pick);
-
-		if ( pick->time < earliest->time )
-			earliest = pick;
 	}
 
 	SEISCOMP_DEBUG("Number of XXL picks=%ld", xxlpicks.size());
@@ -1150,6 +1498,64 @@ Autoloc3::_xxlPreliminaryOrigin(const Autoloc::DataModel::Pick *newPick)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Autoloc3::_xxlSetupStation(const Autoloc::DataModel::Station *station)
+{
+	using namespace Autoloc::DataModel;
+
+	Station::Handle h = station->handle;
+	if (h >= _xxlStations.size()) {
+		_xxlStations.resize(h+1);
+		_xxlNeighbours.resize(h+1);
+		_xxlPicks.resize(h+1);
+	}
+
+	// another location code of a known station
+	if (_xxlStations[h])
+		return;
+	_xxlStations[h] = station;
+
+	for (Station::Handle other=0; other<_xxlStations.size(); other++) {
+		if (other == h || ! _xxlStations[other])
+			continue;
+
+		if (distance(station, _xxlStations[other].get()) > _config.xxlMaxStaDist)
+			continue;
+
+		_xxlNeighbours[h].push_back(other);
+		_xxlNeighbours[other].push_back(h);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Autoloc3::_xxlAddPick(const Autoloc::DataModel::Pick *pick)
+{
+	using namespace Autoloc::DataModel;
+
+	Station::Handle h = pick->station()->handle;
+	if (h >= _xxlPicks.size())
+		_xxlPicks.resize(h+1);
+
+	// forget the picks meanwhile removed from the pick pool
+	std::vector<PickCPtr> &picks = _xxlPicks[h];
+	picks.erase(
+		std::remove_if(picks.begin(), picks.end(),
+			[this](const PickCPtr &p) {
+				return pickFromPool(p->id()) != p.get();
+			}),
+		picks.end());
+
+	picks.push_back(pick);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Autoloc::DataModel::OriginID Autoloc3::_newOriginID()
 {
@@ -1170,9 +1576,9 @@ const Autoloc::DataModel::Pick *Autoloc3::supersedesAnotherPick(const Autoloc::D
 
 	const Autoloc::DataModel::Pick *supersededPick = nullptr;
 
-	for (auto &item: pickPool) {
+	for (const PickCPtr &item: pickPool) {
 
-		const Pick *existingPick = item.second.get();
+		const Pick *existingPick = item.get();
 
 		if (existingPick->blacklisted)
 			continue;
@@ -1222,9 +1628,9 @@ Autoloc3::_trySupersede(const Autoloc::DataModel::Pick *pick)
 
 	OriginPtr associatedOrigin = nullptr;
 
-	for (auto &item: pickPool) {
+	for (const PickCPtr &item: pickPool) {
 
-		const Pick *existingPick = item.second.get();
+		const Pick *existingPick = item.get();
 
 		if (existingPick->blacklisted)
 			continue;
@@ -1269,30 +1675,31 @@ Autoloc3::_trySupersede(const Autoloc::DataModel::Pick *pick)
 						continue;
 					}
 SEISCOMP_DEBUG_S(" TMP- " + printOneliner(origin));
-					associatedOrigin =
-						new Origin(*origin);
+					associatedOrigin = _associationCopy(origin);
 SEISCOMP_DEBUG_S(" TMP+ " + printOneliner(associatedOrigin.get()));
 					int iarr = associatedOrigin->findArrival(existingPick);
 					if (iarr==-1) {
 						THIS_SHOULD_NEVER_HAPPEN;
 						continue;
 					}
-					Arrival &a = associatedOrigin->arrivals[iarr];
+					// A copy, as the arrivals are modified
+					const std::string phase =
+						associatedOrigin->arrivals[iarr].phase;
 
 					bool success = _associate(
-						associatedOrigin.get(), pick, a.phase);
+						associatedOrigin.get(), pick, phase);
 					if (success) {
 						SEISCOMP_WARNING(
 							"Associated pick %s to origin %ld",
 							pick->id().c_str(), associatedOrigin->id);
 						// once again...
 						iarr = associatedOrigin->findArrival(existingPick);
-						Arrival &a = associatedOrigin->arrivals[iarr];
 // FIXME:
 // There is a catch with blacklisting, as we may have replaced a pP pick wrongly labeled
 // as P by a legitimate P pick but still want to be able to use the previous pick correctly
 // as pP. Blacklisting deprives us from that possibility.
-						a.excluded = Arrival::BlacklistedPick;
+						associatedOrigin->arrivals.setExcluded(
+							iarr, Arrival::BlacklistedPick);
 					}
 					else {
 						SEISCOMP_WARNING(
@@ -1364,16 +1771,16 @@ trackedPick=true; // TEMP
 	//
 
 
-	// Only look for possibly associated imported origins
+	// Only look for possibly associated imported or locked origins
 	for (auto &a: associations) {
-		if ( ! imported(a.origin.get()))
+		if ( ! imported(a.origin.get()) && ! a.origin->locked)
 			continue;
 
 		// A bit redundant. TODO: Let the associator check this.
 		if (a.affinity < _config.minPickAffinity)
 			continue;
 
-		OriginPtr associatedOrigin = new Origin(*a.origin.get());
+		OriginPtr associatedOrigin = _associationCopy(a.origin.get());
 
 		bool success = _associate(
 			associatedOrigin.get(), pick, a.phase);
@@ -1389,7 +1796,7 @@ trackedPick=true; // TEMP
 			THIS_SHOULD_NEVER_HAPPEN;
 			return nullptr;
 		}
-		Arrival &arr = associatedOrigin->arrivals[index];
+		const Arrival &arr = associatedOrigin->arrivals[index];
 		SEISCOMP_INFO(
 			"IMP associated pick %s to origin %ld   "
 			"phase=%s aff=%.4f dist=%.1f wt=%d",
@@ -1400,7 +1807,7 @@ trackedPick=true; // TEMP
 	}
 
 	// If at this point we already have found an associated origin, which
-	// must be an imported origin, we are done.
+	// must be an imported or locked origin, we are done.
 	if (origin)
 		return origin;
 
@@ -1411,14 +1818,14 @@ trackedPick=true; // TEMP
 
 	for (auto &a: associations) {
 
-		if ( imported(a.origin.get()) )
+		if ( imported(a.origin.get()) || a.origin->locked )
 			continue;
 
 		// A bit redundant. TODO: Let the associator check this.
 		if (a.affinity < _config.minPickAffinity)
 			continue;
 
-		OriginPtr associatedOrigin = new Origin(*a.origin.get());
+		OriginPtr associatedOrigin = _associationCopy(a.origin.get());
 
 		if (a.phase == "P" || isPKP(a.phase)) {
 			std::string oneliner =
@@ -1452,7 +1859,7 @@ trackedPick=true; // TEMP
 			THIS_SHOULD_NEVER_HAPPEN;
 			return nullptr;
 		}
-		Arrival &arr = associatedOrigin->arrivals[index];
+		const Arrival &arr = associatedOrigin->arrivals[index];
 		SEISCOMP_INFO(
 			"associated pick %s to origin %ld   "
 			"phase=%s aff=%.4f dist=%.1f wt=%d",
@@ -1477,6 +1884,25 @@ trackedPick=true; // TEMP
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Autoloc::DataModel::OriginPtr
+Autoloc3::_associationCopy(const Autoloc::DataModel::Origin *origin) const
+{
+	using namespace Autoloc::DataModel;
+
+	if (_workingOrigins) {
+		auto it = _workingOrigins->find(origin->id);
+		if (it != _workingOrigins->end())
+			return new Origin(*it->second);
+	}
+
+	return new Origin(*origin);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Autoloc::DataModel::OriginPtr
 Autoloc3::_tryNucleate(const Autoloc::DataModel::Pick *pick)
@@ -1489,12 +1915,25 @@ Autoloc3::_tryNucleate(const Autoloc::DataModel::Pick *pick)
 	//
 	// The following will only be executed if the nucleation of a new
 	// origin succeeded.
+	//
+	return _bestCandidate(_nucleator.newOrigins());
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Autoloc::DataModel::OriginPtr
+Autoloc3::_bestCandidate(const Autoloc::DataModel::OriginVector &candidates)
+{
+	using namespace Autoloc::DataModel;
+
 	//
 	// Examine the candidate origins suggested by the nucleator one-by-one
 	// The aim is to find an acceptable new origin.
 	//
 	OriginPtr newOrigin = 0;
-	OriginVector candidates = _nucleator.newOrigins();
 
 	SEISCOMP_DEBUG(
 		"Autoloc3::_tryNucleate A  candidate origins: %d",
@@ -1604,29 +2043,6 @@ Autoloc3::_tryXXL(const Autoloc::DataModel::Pick *pick)
 
 
 
-// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-static size_t countCommonPicks(
-// only used in XXL feature
-	const Autoloc::DataModel::Origin *origin1,
-	const Autoloc::DataModel::Origin *origin2)
-{
-	using namespace Autoloc::DataModel;
-
-	size_t commonPickCount = 0;
-	for (auto &a1: origin1->arrivals) {
-		for (auto &a2: origin2->arrivals) {
-			if (a1.pick == a2.pick)
-				commonPickCount++;
-		}
-	}
-
-	return commonPickCount;
-}
-// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
-
-
-
-
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Autoloc::DataModel::Origin*
 Autoloc3::_xxlFindEquivalentOrigin(const Autoloc::DataModel::Origin *origin)
@@ -1636,8 +2052,14 @@ Autoloc3::_xxlFindEquivalentOrigin(const Autoloc::DataModel::Origin *origin)
 
 	Origin *result = 0;
 
+	std::unordered_map<OriginID, size_t> counts =
+		_origins.pickIndex().commonPickCounts(origin);
+	if (counts.empty())
+		return result;
+
 	for (OriginPtr other : _origins) {
-		size_t count = countCommonPicks(origin, other.get());
+		auto it = counts.find(other->id);
+		size_t count = it != counts.end() ? it->second : 0;
 		if (count >= 3) {
 			if (result) {
 				if (other->score > result->score)
@@ -1656,10 +2078,12 @@ Autoloc3::_xxlFindEquivalentOrigin(const Autoloc::DataModel::Origin *origin)
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-bool Autoloc3::_process(const Autoloc::DataModel::Pick *pick)
+bool Autoloc3::_screen(const Autoloc::DataModel::Pick *pick, bool &accepted)
 {
 	using namespace Autoloc::DataModel;
 
+	accepted = false;
+
 	if (_expired(pick)) {
 		SEISCOMP_INFO_S("ignoring expired pick " + pick->id());
 		return false;
@@ -1696,7 +2120,8 @@ bool Autoloc3::_process(const Autoloc::DataModel::Pick *pick)
 			// picks, i.e. picks that come along with a manual
 			// origin that uses them, we stop here because we
 			// don't want to feed it into the associator/nucleator.
-			return true;
+			accepted = true;
+			return false;
 		}
 		else {
 			pick->blacklisted = true;
@@ -1715,13 +2140,24 @@ bool Autoloc3::_process(const Autoloc::DataModel::Pick *pick)
 	// if ( _perhapsPdiff(pick) )
 	//	return false;
 
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
 
-	// ////////////////////////////////////////////////////////////
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool Autoloc3::_process(const Autoloc::DataModel::Pick *pick)
+{
+	using namespace Autoloc::DataModel;
+
+	bool accepted = false;
+	if ( ! _screen(pick, accepted))
+		return accepted;
+
 	// Now that the pick has passed several filters, it can finally
 	// be processed.
-	// TODO: Perhaps move the above filters to a subroutine.
 
 	SEISCOMP_INFO(
 		"process pick %-35s %s",
@@ -1765,7 +2201,7 @@ SEISCOMP_DEBUG_S("_trySupersede failed for pick "+pick->id()+" which is OK.");
 		// the PKP arrives in central Europe, can be used to take
 		// care of these PKP's.
 
-		if ( imported(origin) ) {
+		if ( imported(origin) || origin->locked ) {
 			// TODO: Review.
 			//       At some point we might want to relocate.
 			//       or at least report the association.
@@ -1784,7 +2220,7 @@ SEISCOMP_DEBUG_S("_trySupersede failed for pick "+pick->id()+" which is OK.");
 
 	// If the origin meets certain criteria, we bypass the nucleator.
 	if ( origin ) {
-		if ( imported(origin) )
+		if ( imported(origin) || origin->locked )
 			return true;
 		if (origin->score >= _config.minScoreBypassNucleator)
 			return true;
@@ -1925,6 +2361,8 @@ bool Autoloc3::_processImportedOrigin(Autoloc::DataModel::Origin *importedOrigin
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::ImportedOrigin);
+
 	// This is the entry point for an external origin from a
 	// trusted agency for passive association only
 
@@ -2061,6 +2499,7 @@ bool Autoloc3::_processImportedOrigin(Autoloc::DataModel::Origin *importedOrigin
 
 		bestMatch->updateFrom(relo.get());
 		bestMatch->referenceOrigin = importedOrigin;
+		_origins.setModified(bestMatch->id);
 
 		SEISCOMP_DEBUG_S(" IMP+ " + printOneliner(bestMatch));
 		SEISCOMP_DEBUG_S(printDetailed(bestMatch));
@@ -2071,6 +2510,7 @@ bool Autoloc3::_processImportedOrigin(Autoloc::DataModel::Origin *importedOrigin
 		bestMatch->updateFrom(fromMatchingPicks.get());
 		bestMatch->referenceOrigin = importedOrigin;
 		bestMatch->locked = true;  // prevent relocation
+		_origins.setModified(bestMatch->id);
 	}
 
 	// TODO: Check residuals and include/remove phases based on
@@ -2091,6 +2531,11 @@ bool Autoloc3::_processManualOrigin(Autoloc::DataModel::Origin *origin)
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::ManualOrigin);
+
+	if (_config.passiveManualOrigins)
+		return _processPassiveOrigin(origin);
+
 	const Origin *manualOrigin = origin;
 
 	if ( manualOrigin->arrivals.empty() ) {
@@ -2176,6 +2621,7 @@ bool Autoloc3::_processManualOrigin(Autoloc::DataModel::Origin *origin)
 		*found = *manualOrigin;
 		found->arrivals = arrivals;
 		found->id = id;
+		_origins.setModified(id);
 
 		switch (manualOrigin->depthType) {
 		case Origin::DepthManuallyFixed:
@@ -2226,6 +2672,89 @@ bool Autoloc3::_processManualOrigin(Autoloc::DataModel::Origin *origin)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool Autoloc3::_processPassiveOrigin(Autoloc::DataModel::Origin *origin)
+{
+	using namespace Autoloc::DataModel;
+
+	// Passive processing of a trusted origin. The location is
+	// adopted as is and kept fixed by locking the origin. We only
+	// associate matching picks and update the score but never
+	// relocate. Later picks are associated the same way, see
+	// _associate().
+
+	SEISCOMP_INFO(
+		"processing origin passively z=%.3fkm   dtype=%d",
+		origin->dep, origin->depthType);
+
+	OriginID id = _findMatchingOrigin(origin);
+	Origin *found = _origins.find(id);
+
+	OriginPtr passiveOrigin = new Origin(*origin);
+	passiveOrigin->arrivals.clear();
+	passiveOrigin->locked = true;
+
+	if (found) {
+		SEISCOMP_INFO_S(" PAS " + printOneliner(found));
+		passiveOrigin->id = found->id;
+	}
+	else
+		passiveOrigin->id = _newOriginID();
+
+	// The arrivals of the trusted origin are taken over unchanged.
+	for (auto &a: origin->arrivals) {
+		if ( ! a.pick->station())
+			continue;
+		passiveOrigin->arrivals.push_back(a);
+	}
+
+	// Add matching picks not yet associated to another origin.
+	// As the origin is locked, _associate() won't relocate.
+	AssociationVector associations;
+	_associator.findMatchingPicks(passiveOrigin.get(), associations);
+	for (auto &a: associations) {
+		const Pick *pick = a.pick.get();
+
+		if (passiveOrigin->findArrival(pick) >= 0)
+			continue;
+
+		if (pick->originID() && pick->originID() != passiveOrigin->id)
+			continue;
+
+		if (_requiresAmplitude(pick) && ! hasAmplitude(pick))
+			continue;
+
+		if (_associate(passiveOrigin.get(), pick, a.phase))
+			SEISCOMP_INFO(
+				"PAS ADD %5s %5s  %6.2f",
+				pick->station()->code.c_str(),
+				a.phase.c_str(), a.residual);
+	}
+	passiveOrigin->arrivals.sort();
+
+	for (auto &a: passiveOrigin->arrivals) {
+		if (a.excluded)
+			continue;
+		passiveOrigin->adopt(a.pick.get());
+	}
+
+	if (found) {
+		*found = *passiveOrigin;
+		_store(found);
+	}
+	else
+		_store(passiveOrigin.get());
+
+	report();
+	cleanup();
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool Autoloc3::_processQualifiedOrigin(Autoloc::DataModel::Origin *origin)
 {
@@ -2267,6 +2796,8 @@ bool Autoloc3::_setDefaultDepth(Autoloc::DataModel::Origin *origin)
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::Depth);
+
 	OriginPtr test = new Origin(*origin);
 
 	_relocator.setFixedDepth(_config.defaultDepth);
@@ -2292,6 +2823,8 @@ bool Autoloc3::_setTheRightDepth(Autoloc::DataModel::Origin *origin)
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::Depth);
+
 	if ( ! _config.tryDefaultDepth)
 		return false;
 
@@ -2303,11 +2836,11 @@ bool Autoloc3::_setTheRightDepth(Autoloc::DataModel::Origin *origin)
 	// kommt. Sonst bleibt das immer bei der Default-Tiefe haengen!
 	if (origin->depthType == Origin::DepthDefault) {
 		// TODO: improve
-		OriginPtr test = new Origin(*origin);
-		test->depthType = Origin::DepthFree;
+		DepthScan scan;
+		_depthScan(origin, _config.depthScanDepths, scan);
 
 		_relocator.useFixedDepth(false);
-		OriginPtr relo = _relocator.relocate(test.get());
+		OriginPtr relo = scan.freeDepth()->relo;
 		if ( ! relo) {
 			SEISCOMP_WARNING(
 				"_setDefaultDepth: failed relocation");
@@ -2416,7 +2949,7 @@ bool Autoloc3::_requiresAmplitude(const Autoloc::DataModel::Pick *pick) const
 	// TODO: Review as there may be automatic picks that don't
 	// require all amplitudes.
 
-	if (pick->scpick->methodID() == "DL")
+	if (pick->methodID() == "DL")
 		// XXX TEMP HACK XXX for deep-learning picks XXX
 		return false;
 
@@ -2447,11 +2980,17 @@ void Autoloc3::_ensureConsistentArrivals(Autoloc::DataModel::Origin *origin)
 	using namespace Autoloc::DataModel;
 
 	// ensure consistent distances/azimuths of the arrivals
-	for (auto &a: origin->arrivals) {
+	for (size_t i=0; i<origin->arrivals.size(); i++) {
+		const Arrival &arr = origin->arrivals[i];
 		double delta, az, baz;
-		delazi(origin, a.pick->station(), delta, az, baz);
+		delazi(origin, arr.pick->station(), delta, az, baz);
+		if (arr.distance == delta && arr.azimuth == az)
+			continue;
+
+		Arrival a = arr;
 		a.distance = delta;
 		a.azimuth = az;
+		origin->arrivals.set(i, a);
 	}
 
 	origin->arrivals.sort();
@@ -2466,6 +3005,8 @@ void Autoloc3::_ensureAcceptableRMS(Autoloc::DataModel::Origin *origin, bool kee
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::EnsureAcceptableRMS);
+
 	int minPhaseCount = 20; // TODO: make this configurable
 
 	if (origin->definingPhaseCount() < minPhaseCount)
@@ -2499,8 +3040,8 @@ void Autoloc3::_ensureAcceptableRMS(Autoloc::DataModel::Origin *origin, bool kee
 		}
 		else {
 			int worst = arrivalWithLargestResidual(origin);
-			origin->arrivals[worst].excluded =
-				Arrival::LargeResidual;
+			origin->arrivals.setExcluded(
+				worst, Arrival::LargeResidual);
 			_relocator.useFixedDepth(keepDepth ? true : false);
 			LOG_RELOCATOR_CALL;
 			OriginPtr relo = _relocator.relocate(origin);
@@ -2527,7 +3068,11 @@ void Autoloc3::_updateScore(Autoloc::DataModel::Origin *origin)
 {
 	using namespace Autoloc::DataModel;
 
-	origin->score = _score(origin);
+	// The score computation doesn't modify the origin. Here we
+	// still sort the arrivals by distance and keep the score of
+	// each arrival, which e.g. _testFake() relies on.
+	origin->arrivals.sort();
+	origin->score = Autoloc::updateArrivalScores(origin);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -2539,6 +3084,8 @@ bool Autoloc3::_rework(Autoloc::DataModel::Origin *origin)
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::Rework);
+
 #ifdef EXTRA_DEBUGGING
 	SEISCOMP_DEBUG("_rework begin   deperr=%.1f", origin->deperr);
 #endif
@@ -2640,7 +3187,7 @@ bool Autoloc3::_rework(Autoloc::DataModel::Origin *origin)
 		// find the farthest used station
 		for (int i=0; i<arrivalCount; i++) {
 
-			Arrival &a = origin->arrivals[i];
+			const Arrival &a = origin->arrivals[i];
 			if (a.excluded)
 				continue;
 			if (a.distance > dmax) {
@@ -2649,10 +3196,10 @@ bool Autoloc3::_rework(Autoloc::DataModel::Origin *origin)
 			}
 		}
 
-		Arrival &a = origin->arrivals[imax];
+		const Arrival &a = origin->arrivals[imax];
 		if (a.distance < _config.maxStaDist)
 			break;
-		a.excluded = Arrival::StationDistance;
+		origin->arrivals.setExcluded(imax, Arrival::StationDistance);
 
 		// relocate once
 		LOG_RELOCATOR_CALL;
@@ -2737,7 +3284,8 @@ bool Autoloc3::_excludePKP(Autoloc::DataModel::Origin *origin)
 	using namespace Autoloc::DataModel;
 SEISCOMP_DEBUG("_excludePKP");
 	bool relocate = false;
-	for (auto &a: origin->arrivals) {
+	for (size_t i=0; i<origin->arrivals.size(); i++) {
+		const Arrival &a = origin->arrivals[i];
 		if (a.excluded)
 			continue;
 		if (a.distance < 105)
@@ -2748,8 +3296,9 @@ SEISCOMP_DEBUG("_excludePKP");
 		    /* || arr.phase == "PKiKP" */ ) {
 			// for times > 960, we expect P to be PKP
 			if (a.pick->time - origin->time > 960) {
-				a.excluded = Arrival::UnusedPhase;
 SEISCOMP_DEBUG_S("_excludePKP pick="+a.pick->id());
+				origin->arrivals.setExcluded(
+					i, Arrival::UnusedPhase);
 				relocate = true;
 			}
 		}
@@ -2813,15 +3362,17 @@ bool Autoloc3::_excludeDistantStations(Autoloc::DataModel::Origin *origin)
 	}
 
 	int excludedCount = 0;
-	for (auto &a: origin->arrivals) {
+	for (size_t i=0; i<origin->arrivals.size(); i++) {
+		const Arrival &a = origin->arrivals[i];
 		if (a.excluded)
 			continue;
 		if (a.distance > maxDistance) {
-			a.excluded = Arrival::StationDistance;
 			excludedCount++;
 			SEISCOMP_DEBUG(
 				"_excludeDistantStations origin %ld exc %s",
 				origin->id, a.pick->id().c_str());
+			origin->arrivals.setExcluded(
+				i, Arrival::StationDistance);
 		}
 	}
 	if (excludedCount) {
@@ -2944,12 +3495,14 @@ bool Autoloc3::_store(Autoloc::DataModel::Origin *origin)
 	Origin *existing = _origins.find(origin->id);
 	if (existing) {
 		existing->updateFrom(origin);
+		_origins.setModified(existing->id);
 		origin = existing;
 		SEISCOMP_INFO_S(" UPD " + printOneliner(origin));
 	}
 	else {
 		SEISCOMP_INFO_S(" NEW " + printOneliner(origin));
-		_origins.push_back(origin);
+		_origins.add(origin);
+		_originExpiry.push(origin->time, origin->id);
 	}
 
 	// Some additional log output only if we don't send the origin.
@@ -2986,6 +3539,8 @@ bool Autoloc3::_associate(
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::Associate);
+
 if (isPKP(phase)) SEISCOMP_DEBUG("_associate PKP?? A");
 
 	const std::string &pickID = pick->id();
@@ -3211,8 +3766,7 @@ if (isPKP(phase)) SEISCOMP_DEBUG("_associate PKP?? J");
 				SEISCOMP_ERROR("Pick is %s", pick->id().c_str());
 				return false;
 			}
-			Arrival &arr = copy->arrivals[index];
-			arr.excluded = Arrival::LargeResidual;
+			copy->arrivals.setExcluded(index, Arrival::LargeResidual);
 
 			// relocate anyway, to get consistent residuals even
 			// for the unused picks
@@ -3256,7 +3810,7 @@ if (isPKP(phase)) SEISCOMP_DEBUG("_associate PKP?? J");
 				return false;
 			}
 
-			Arrival &arr = relo->arrivals[index];
+			Arrival arr = relo->arrivals[index];
 			if (std::abs(arr.residual) > _config.maxResidualUse) {
 				// Added arrival but pick is not used
 				// due to large residual.
@@ -3294,20 +3848,6 @@ bool Autoloc3::_addMorePicks(
 
 	using namespace Autoloc::DataModel;
 
-	std::set<std::string> have;
-	for (auto &a: origin->arrivals) {
-		if (a.excluded)
-			continue;
-
-		const Pick *pick = a.pick.get();
-		if ( ! pick->station() )
-			continue;
-		std::string x =
-			pick->station()->net + "." +
-			pick->station()->code + ":" + a.phase;
-		have.insert(x);
-	}
-
 	SEISCOMP_DEBUG("_addMorePicks begin");
 
         bool considerDisabledStations =
@@ -3439,6 +3979,8 @@ bool Autoloc3::_enhanceScore(Autoloc::DataModel::Origin *origin, size_t maxloops
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::EnhanceScore);
+
 	// TODO: make sure that the RMS doesn't increase too badly!
 	size_t count = 0, loops = 0;
 
@@ -3468,11 +4010,11 @@ bool Autoloc3::_enhanceScore(Autoloc::DataModel::Origin *origin, size_t maxloops
 			size_t excludedCount = 0;
 			size_t arrivalCount = origin->arrivals.size();
 			for (size_t i=0; i<arrivalCount; i++) {
-				Arrival &arr = origin->arrivals[i];
+				const Arrival &arr = origin->arrivals[i];
 				if ( ! arr.pick->xxl &&
 				     arr.pick->time < earliestxxl->time) {
-					copy->arrivals[i].excluded =
-						Arrival::ManuallyExcluded;
+					copy->arrivals.setExcluded(
+						i, Arrival::ManuallyExcluded);
 					excludedCount++;
 				}
 			}
@@ -3498,50 +4040,116 @@ bool Autoloc3::_enhanceScore(Autoloc::DataModel::Origin *origin, size_t maxloops
 		}
 	}
 
-	// try to enhance score by excluding outliers
-//	while (origin->definingPhaseCount() >= _config.minPhaseCount) {
-	NEVER_RUN_THIS_LOOP { // XXX FIXME XXX TEMP XXX
+	// Try to enhance the score by excluding outliers. In each
+	// iteration, the most suspicious arrivals, i.e. those with the
+	// largest residuals, are excluded one at a time and the origin
+	// is relocated. The trial relocations are independent of each
+	// other and are performed by the locator pool. The exclusion
+	// resulting in the best score is kept.
+	const std::chrono::steady_clock::time_point
+		startTime = std::chrono::steady_clock::now();
+	while (origin->definingPhaseCount() >= _config.minPhaseCount) {
 
 		if (++loops > maxloops)
 			break;
 
+		if (_config.enhanceScoreMaxTrials <= 0)
+			break;
+
 		double currentScore = _score(origin);
 		double bestScore = currentScore;
-		int    bestExcluded = -1;
+		OriginPtr best;
+		int bestExcluded = -1;
 
+		std::vector<int> candidates;
 		int arrivalCount = origin->arrivals.size();
 		for (int i=0; i<arrivalCount; i++) {
+			if ( ! origin->arrivals[i].excluded)
+				candidates.push_back(i);
+		}
+		std::stable_sort(candidates.begin(), candidates.end(),
+			[origin](int i, int k) {
+				return std::abs(origin->arrivals[i].residual) >
+				       std::abs(origin->arrivals[k].residual);
+			});
+		if (candidates.size() > size_t(_config.enhanceScoreMaxTrials))
+			candidates.resize(_config.enhanceScoreMaxTrials);
+
+		// The trials are processed in batches of the pool size so
+		// that the time budget can be checked in between.
+		size_t batchSize = _relocatorPool.size();
+		bool timeBudgetExceeded = false;
+		for (size_t first=0; first<candidates.size(); first+=batchSize) {
+
+			if (_config.enhanceScoreTimeBudget > 0) {
+				std::chrono::duration<double> elapsed =
+					std::chrono::steady_clock::now() - startTime;
+				if (elapsed.count() > _config.enhanceScoreTimeBudget) {
+					timeBudgetExceeded = true;
+					break;
+				}
+			}
 
-			Arrival &a = origin->arrivals[i];
-			if (a.excluded)
-				continue;
+			size_t last = std::min(candidates.size(), first+batchSize);
+
+			OriginVector copies;
+			RelocationRequestVector requests;
+			for (size_t k=first; k<last; k++) {
+				OriginPtr copy = new Origin(*origin);
+				copy->arrivals.setExcluded(
+					candidates[k], Arrival::LargeResidual);
+				copies.push_back(copy);
+
+				RelocationRequest request;
+				request.origin = copy.get();
+				request.fixedDepth = false;
+				request.depth = 0;
+				request.callSite = RelocationStatistics::EnhanceScore;
+				requests.push_back(request);
+			}
 
-			OriginPtr copy = new Origin(*origin);
-			copy->arrivals[i].excluded = Arrival::ManuallyExcluded;
+			OriginVector relocated;
+			_relocatorPool.relocate(requests, relocated);
 
-			_relocator.useFixedDepth(false);
-			LOG_RELOCATOR_CALL;
-			OriginPtr relo = _relocator.relocate(copy.get());
-			if ( ! relo) {
-				// try again, now using fixed depth (this sometimes helps)
-				// TODO: figure out why this sometimes helps and whether there is a better way
-				_relocator.useFixedDepth(true);
-				LOG_RELOCATOR_CALL;
-				relo = _relocator.relocate(copy.get());
-				if ( ! relo)
+			// try again the failed ones, now using fixed depth
+			// (this sometimes helps)
+			RelocationRequestVector retryRequests;
+			std::vector<size_t> retryIndices;
+			for (size_t k=0; k<relocated.size(); k++) {
+				if (relocated[k])
 					continue;
+				RelocationRequest request = requests[k];
+				request.fixedDepth = true;
+				request.depth = origin->dep;
+				retryRequests.push_back(request);
+				retryIndices.push_back(k);
+			}
+			if ( ! retryRequests.empty()) {
+				OriginVector retried;
+				_relocatorPool.relocate(retryRequests, retried);
+				for (size_t k=0; k<retried.size(); k++)
+					relocated[retryIndices[k]] = retried[k];
 			}
 
-			double score = _score(relo.get());
+			// in candidate order, independent of the pool size
+			for (size_t k=0; k<relocated.size(); k++) {
+				if ( ! relocated[k])
+					continue;
 
-			if (score>bestScore) {
-				bestScore = score;
-				bestExcluded = i;
+				double score = _score(relocated[k].get());
+				if (score > bestScore) {
+					bestScore = score;
+					best = relocated[k];
+					bestExcluded = candidates[first+k];
+				}
 			}
-
-			a.excluded = Arrival::NotExcluded;
 		}
 
+		if (timeBudgetExceeded)
+			SEISCOMP_DEBUG(
+				"_enhanceScore: time budget of %g s exceeded",
+				_config.enhanceScoreTimeBudget);
+
 		if (bestExcluded == -1)
 			break;
 
@@ -3551,29 +4159,16 @@ bool Autoloc3::_enhanceScore(Autoloc::DataModel::Origin *origin, size_t maxloops
 		if (bestScore < currentScore+0.2)
 			break;
 
-		OriginPtr copy = new Origin(*origin);
-		Arrival &a = copy->arrivals[bestExcluded];
-		a.excluded = Arrival::LargeResidual;
-
-		_relocator.useFixedDepth(false);
-		LOG_RELOCATOR_CALL;
-		OriginPtr relo = _relocator.relocate(copy.get());
-		if ( ! relo) {
-			// try again, now using fixed depth (this sometimes helps)
-			_relocator.useFixedDepth(true);
-			LOG_RELOCATOR_CALL;
-			relo = _relocator.relocate(copy.get());
-			if ( ! relo) // give up if fixing depth didn't help
-				continue;
-		}
-
 		if (bestScore > 5)  // don't spoil the log
 			SEISCOMP_DEBUG_S(
-				" ENH " + printOneliner(relo.get()) +
-				" exc " + a.pick->id());
+				" ENH " + printOneliner(best.get()) +
+				" exc " + origin->arrivals[bestExcluded].pick->id());
 
-		origin->updateFrom(relo.get());
+		origin->updateFrom(best.get());
 		count ++;
+
+		if (timeBudgetExceeded)
+			break;
 	}
 
 	return (count > 0);
@@ -3591,15 +4186,20 @@ void Autoloc3::_rename_P_PKP(Autoloc::DataModel::Origin *origin)
 
 	using namespace Autoloc::DataModel;
 
-	for (auto &a: origin->arrivals) {
+	for (size_t i=0; i<origin->arrivals.size(); i++) {
+		Arrival a = origin->arrivals[i];
 		double dt = a.pick->time-origin->time;
 
 		if ( a.distance > 105 && dt > 960 && a.phase == "P" ) {
 			a.phase = "PKP";
 		}
-		if ( a.distance < 125 && dt < 960 && isPKP(a.phase)) {
+		else if ( a.distance < 125 && dt < 960 && isPKP(a.phase)) {
 			a.phase = "P";
 		}
+		else
+			continue;
+
+		origin->arrivals.set(i, a);
 	}
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -3633,6 +4233,10 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 	double maxProbability = 0;
 	int arrivalCount = origin->arrivals.size();
 
+	// Only the exclusion of arrivals of the origin is modified
+	// below, so the index remains valid.
+	const OriginRegistry::PickIndex &pickIndex = _origins.pickIndex();
+
 	for (const auto otherOrigin : _origins) {
 		int count = 0;
 
@@ -3658,17 +4262,19 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 		int definingPhaseCount = origin->definingPhaseCount();
 		for (int i=0; i<arrivalCount; i++) {
 
-			Arrival &arr = origin->arrivals[i];
+			// Only read, an exclusion is set through the
+			// vector after which arr is no longer used
+			const Arrival &arr = origin->arrivals[i];
 //			if (arr.excluded)
 //				continue;
 
 			// see if otherOrigin references this pick already
-			int iarr = otherOrigin->findArrival(arr.pick.get());
+			int iarr = pickIndex.findArrival(otherOrigin->id, arr.pick.get());
 			if (iarr != -1) {
 				const Arrival &oarr =
 					otherOrigin->arrivals[iarr];
 //				if ( ! arr.excluded) {
-					arr.excluded = Arrival::DeterioratesSolution;
+					origin->arrivals.setExcluded(i, Arrival::DeterioratesSolution);
 					SEISCOMP_DEBUG(
 						"_testFake: doubly associated "
 						"pick %s",
@@ -3692,7 +4298,7 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 					double dt = arr.pick->time - (otherOrigin->time + tt->time);
 					if (dt > -20 && dt < 30) {
 						if (std::abs(dt) < std::abs(arr.residual))
-							arr.excluded = Arrival::DeterioratesSolution;
+							origin->arrivals.setExcluded(i, Arrival::DeterioratesSolution);
 						SEISCOMP_DEBUG("_testFake: %-6s %5lu %5lu PP   dt=%.1f", sta->code.c_str(),origin->id, otherOrigin->id, dt);
 						count ++;
 						delete ttlist;
@@ -3707,7 +4313,7 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 					double dt = arr.pick->time - (otherOrigin->time + tt->time);
 					if (dt > -20 && dt < 50) { // a bit more generous for PKP
 						if (std::abs(dt) < std::abs(arr.residual))
-							arr.excluded = Arrival::DeterioratesSolution;
+							origin->arrivals.setExcluded(i, Arrival::DeterioratesSolution);
 						SEISCOMP_DEBUG("_testFake: %-6s %5lu %5lu PKP  dt=%.1f", sta->code.c_str(),origin->id, otherOrigin->id, dt);
 						count ++;
 						delete ttlist;
@@ -3723,7 +4329,7 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 					double dt = arr.pick->time - (otherOrigin->time + tt->time);
 					if (dt > -20 && dt < 50) { // a bit more generous for SKP
 						if (std::abs(dt) < std::abs(arr.residual))
-							arr.excluded = Arrival::DeterioratesSolution;
+							origin->arrivals.setExcluded(i, Arrival::DeterioratesSolution);
 						SEISCOMP_DEBUG("_testFake: %-6s %5lu %5lu SKP  dt=%.1f", sta->code.c_str(),origin->id, otherOrigin->id, dt);
 						count ++;
 						delete ttlist;
@@ -3738,7 +4344,7 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 					double dt = arr.pick->time - (otherOrigin->time + tt->time);
 					if (dt > -20 && dt < 50) { // a bit more generous for PKKP
 						if (std::abs(dt) < std::abs(arr.residual))
-							arr.excluded = Arrival::DeterioratesSolution;
+							origin->arrivals.setExcluded(i, Arrival::DeterioratesSolution);
 						SEISCOMP_DEBUG("_testFake: %-6s %5lu %5lu PKKP dt=%.1f", sta->code.c_str(),origin->id, otherOrigin->id, dt);
 						count ++;
 						delete ttlist;
@@ -3753,7 +4359,7 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 					double dt = arr.pick->time - (otherOrigin->time + tt->time);
 					if (dt > -20 && dt < 30) {
 						if (std::abs(dt) < std::abs(arr.residual))
-							arr.excluded = Arrival::DeterioratesSolution;
+							origin->arrivals.setExcluded(i, Arrival::DeterioratesSolution);
 						SEISCOMP_DEBUG("_testFake: %-6s %5lu %5lu pP   dt=%.1f", sta->code.c_str(),origin->id, otherOrigin->id, dt);
 						count ++;
 						delete ttlist;
@@ -3766,7 +4372,7 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 					double dt = arr.pick->time - (otherOrigin->time + tt->time);
 					if (dt > -20 && dt < 30) {
 						if (std::abs(dt) < std::abs(arr.residual))
-							arr.excluded = Arrival::DeterioratesSolution;
+							origin->arrivals.setExcluded(i, Arrival::DeterioratesSolution);
 						SEISCOMP_DEBUG("_testFake: %-6s %5lu %5lu sP   dt=%.1f", sta->code.c_str(),origin->id, otherOrigin->id, dt);
 						count ++;
 						delete ttlist;
@@ -3781,7 +4387,7 @@ double Autoloc3::_testFake(Autoloc::DataModel::Origin *origin) const
 					double dt = arr.pick->time - (otherOrigin->time + tt->time);
 					if (dt > -20 && dt < 30) {
 						if (std::abs(dt) < std::abs(arr.residual))
-							arr.excluded = Arrival::DeterioratesSolution;
+							origin->arrivals.setExcluded(i, Arrival::DeterioratesSolution);
 						SEISCOMP_DEBUG("_testFake: %-6s %5lu %5lu S    dt=%.1f", sta->code.c_str(),origin->id, otherOrigin->id, dt);
 						count ++;
 						delete ttlist;
@@ -3838,22 +4444,21 @@ int Autoloc3::_removeWorstOutliers(Autoloc::DataModel::Origin *origin)
 	int count = 0;
 	std::vector<std::string> removed;
 
-	for (ArrivalVector::iterator
-	     it = origin->arrivals.begin(); it != origin->arrivals.end();) {
+	for (size_t i=0; i<origin->arrivals.size();) {
 
-		Arrival &arr = *it;
+		const Arrival &arr = origin->arrivals[i];
 
 		if (arr.excluded &&
 		    std::abs(arr.residual) > _config.maxResidualKeep) {
 
 			arr.pick->setOriginID(0); // disassociate the pick
 			removed.push_back(arr.pick->id());
-			it = origin->arrivals.erase(it);
+			origin->arrivals.erase(i);
 			count++;
 			// TODO try to re-associate the released pick
 			//      with other origin
 		}
-		else ++it;
+		else ++i;
 	}
 
 	if (count==0)
@@ -3936,6 +4541,8 @@ bool Autoloc3::_trimResiduals(Autoloc::DataModel::Origin *origin)
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::TrimResiduals);
+
 	int arrivalCount = origin->arrivals.size();
 	int count = 0;
 
@@ -3945,7 +4552,7 @@ bool Autoloc3::_trimResiduals(Autoloc::DataModel::Origin *origin)
 
 		for (int i=0; i<arrivalCount; i++) {
 
-			Arrival &arr = origin->arrivals[i];
+			const Arrival &arr = origin->arrivals[i];
 			if (arr.excluded)
 				continue;
 
@@ -3971,8 +4578,8 @@ bool Autoloc3::_trimResiduals(Autoloc::DataModel::Origin *origin)
 			break;
 
 		OriginPtr copy = new Origin(*origin);
-		Arrival &arr = copy->arrivals[maxIndex];
-		arr.excluded = Arrival::LargeResidual;
+		copy->arrivals.setExcluded(maxIndex, Arrival::LargeResidual);
+		const Arrival &arr = copy->arrivals[maxIndex];
 
 		// NOTE that the behavior of _relocator is configured 
 		// outside this routine
@@ -3995,7 +4602,7 @@ bool Autoloc3::_trimResiduals(Autoloc::DataModel::Origin *origin)
 
 		for (int i=0; i<arrivalCount; i++) {
 
-			Arrival &arr = origin->arrivals[i];
+			const Arrival &arr = origin->arrivals[i];
 			if (arr.excluded != Arrival::LargeResidual)
 				continue;
 
@@ -4011,8 +4618,8 @@ bool Autoloc3::_trimResiduals(Autoloc::DataModel::Origin *origin)
 			break;
 
 		OriginPtr copy = new Origin(*origin);
-		Arrival &arr = copy->arrivals[minIndex];
-		arr.excluded = Arrival::NotExcluded;
+		copy->arrivals.setExcluded(minIndex, Arrival::NotExcluded);
+		const Arrival &arr = copy->arrivals[minIndex];
 
 		SEISCOMP_DEBUG_S(
 			" TRX " + printOneliner(origin));
@@ -4109,11 +4716,15 @@ bool Autoloc3::setupStation(
 			sta->maxNucDist = c.maxNucDist;
 			sta->maxLocDist = 180;
 			sta->enabled = c.usage > 0;
+			sta->handle = _stationRegistry.handle(sta->net, sta->code);
 
 			_stations[key] = sta;
+			if (_config.xxlEnabled)
+				_xxlSetupStation(sta);
 
 			// propagate to _nucleator and _relocator
 			_relocator.setStation(sta);
+			_relocatorPool.setStation(sta);
 			_nucleator.setStation(sta);
 
 			SEISCOMP_DEBUG(
@@ -4171,6 +4782,7 @@ void Autoloc3::setLocatorProfile(const std::string &profile) {
 	SEISCOMP_DEBUG_S("Setting configured locator profile: " + profile);
 	_nucleator.setLocatorProfile(profile);
 	_relocator.setProfile(profile);
+	_relocatorPool.setProfile(profile);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -4270,10 +4882,15 @@ void Autoloc3::reset()
 	SEISCOMP_INFO("reset requested");
 	_associator.reset();
 	_nucleator.reset();
-	_outgoing.clear();
 	_origins.clear();
-	_lastSent.clear();
 	pickPool.clear();
+	_pickExpiry.clear();
+	_originExpiry.clear();
+	_scPickExpiry.clear();
+	// keep one list per station, the neighbour lists refer to them
+	for (auto &picks: _xxlPicks)
+		picks.clear();
+	_batch.clear();
 	_newOrigins.clear();
 //	cleanup(now());
 }
@@ -4287,6 +4904,8 @@ void Autoloc3::shutdown()
 {
 	SEISCOMP_INFO("shutting down autoloc");
 
+	_dumpRelocationStatistics();
+
 	reset();
 	_associator.shutdown();
 	_nucleator.shutdown();
@@ -4296,6 +4915,20 @@ void Autoloc3::shutdown()
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Autoloc3::_dumpRelocationStatistics() const
+{
+	// all locator instances, counted since startup
+	RelocationStatistics statistics = _relocator.statistics();
+	statistics.merge(_relocatorPool.statistics());
+	statistics.merge(_nucleator.relocationStatistics());
+	statistics.dump("per call site since startup");
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void Autoloc3::trackPick(const std::string &pickID)
 {
@@ -4322,31 +4955,66 @@ void Autoloc3::cleanup(Autoloc::DataModel::Time minTime)
 	using namespace Autoloc::DataModel;
 
 	if ( ! minTime) {
-		minTime = _now - _config.maxAge - 1800;
+		if (_config.maxAge <= 0)
+			return;
+
+		// Old objects are released in small steps with every call.
+		// The periodic part is only for the log output.
+		_expire(_now - _config.maxAge - 1800);
 
 		if (_now < _nextCleanup)
 			return;
-		if (_config.maxAge <= 0)
-			return;
+		_nextCleanup = _now + _config.cleanupInterval;
+
+		SEISCOMP_INFO(
+			"CLEANUP **** picks    %d / %d  pending %d",
+			int(pickPool.size()), Pick::count(),
+			int(_pickExpiry.size()));
+		SEISCOMP_INFO(
+			"CLEANUP **** origins  %d / %d  pending %d",
+			int(_origins.size()), Origin::count(),
+			int(_originExpiry.size()));
+		SEISCOMP_INFO(
+			"CLEANUP **** arrival copies  %lu shared / %lu made",
+			(unsigned long)ArrivalVector::sharedCount(),
+			(unsigned long)ArrivalVector::detachedCount());
+		const Autoloc::Arena::Statistics &arena = _arena.statistics();
+		SEISCOMP_INFO(
+			"CLEANUP **** arena  %.1f allocations per feed, "
+			"max %lu (%lu bytes), %lu from heap, "
+			"buffer %lu bytes (max %lu)",
+			arena.rounds ? double(arena.allocations)/arena.rounds : 0.,
+			(unsigned long)arena.maxAllocations,
+			(unsigned long)arena.maxBytes,
+			(unsigned long)arena.heapAllocations,
+			(unsigned long)arena.bufferSize,
+			(unsigned long)arena.maxBufferSize);
+
+		_dumpRelocationStatistics();
+		dumpState();
+		return;
 	}
 
+	// With an explicit minTime everything is swept at once.
+
 	int beforePickCount   = Pick::count();
 	int beforeOriginCount = Origin::count();
 
 	// clean up pick pool
-	for(PickPool::iterator
-	    it = pickPool.begin(); it != pickPool.end(); ) {
+	std::vector<PickPool::Handle> expired;
+	for(PickPool::const_iterator
+	    it = pickPool.begin(); it != pickPool.end(); ++it) {
 
-		PickCPtr pick = it->second;
+		const Pick *pick = it->get();
 		if (pick->time < minTime)
-			pickPool.erase(it++);
-		else ++it;
+			expired.push_back(it.handle());
 	}
+	for (PickPool::Handle handle: expired)
+		pickPool.erase(handle);
 
 	int nclean = _nucleator.cleanup(minTime);
 	SEISCOMP_INFO(
 		"CLEANUP: Nucleator: %d items removed", nclean);
-	_nextCleanup = _now + _config.cleanupInterval;
 	SEISCOMP_INFO(
 		"CLEANUP **** picks    %d / %d",
 		beforePickCount, Pick::count());
@@ -4354,36 +5022,62 @@ void Autoloc3::cleanup(Autoloc::DataModel::Time minTime)
 		"CLEANUP **** origins  %d / %d",
 		beforeOriginCount, Origin::count());
 
-	OriginVector _originsTmp;
-	for(OriginVector::iterator
-	    it = _origins.begin(); it != _origins.end(); ++it) {
+	_dumpRelocationStatistics();
 
-		OriginPtr origin = *it;
+	// removes the origins along with their publication state
+	_origins.removeOlderThan(minTime);
+	dumpState();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
-		if (origin->time < minTime)
-			continue;
 
-		_originsTmp.push_back(origin);
-	}
-	_origins = _originsTmp;
 
 
-	std::vector<OriginID> ids;
-	for (std::map<int, OriginPtr>::iterator
-	     it = _lastSent.begin(); it != _lastSent.end(); ++it) {
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Autoloc3::_expire(Autoloc::DataModel::Time minTime)
+{
+	using namespace Autoloc::DataModel;
 
-		const Origin *origin = it->second.get();
-		if (origin->time < minTime)
-			ids.push_back(origin->id);
-	}
+	size_t step = std::max(1, _config.cleanupStepSize);
 
-	for(std::vector<OriginID>::iterator
-	    it = ids.begin(); it != ids.end(); ++it) {
+	_pickExpiry.expire(minTime, step, [this](const PickCPtr &pick) {
+		// The handle may meanwhile belong to another pick.
+		PickPool::Handle handle = pick->poolHandle();
+		if (pickPool.get(handle) == pick.get())
+			pickPool.erase(handle);
+	});
 
-		OriginID id = *it;
-		_lastSent.erase(id);
+	if (_config.scPickKeep > 0) {
+		// The SC pick is needed by the locator for relocations,
+		// so it is kept as long as any origin refers to the pick.
+		const OriginRegistry::PickIndex &pickIndex = _origins.pickIndex();
+		_scPickExpiry.expire(
+			_now - _config.scPickKeep, step,
+			[&pickIndex](const PickCPtr &pick) {
+				if ( ! pick->originID() && ! pickIndex.find(pick.get()))
+					pick->releaseSCPick();
+			});
 	}
-	dumpState();
+
+	std::vector<OriginID> ids;
+	_originExpiry.expire(minTime, step, [&](const OriginID &id) {
+		const Origin *origin = _origins.find(id);
+		if ( ! origin)
+			return;
+
+		// A relocated origin may have moved in time.
+		if (origin->time >= minTime) {
+			_originExpiry.push(origin->time, id);
+			return;
+		}
+
+		ids.push_back(id);
+	});
+
+	// removes the origins along with their publication state
+	_origins.remove(ids);
+
+	_nucleator.cleanup(minTime, step);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -4395,6 +5089,8 @@ bool Autoloc3::_depthIsResolvable(Autoloc::DataModel::Origin *origin)
 {
 	using namespace Autoloc::DataModel;
 
+	Locator::CallSiteScope callSite(_relocator, RelocationStatistics::Depth);
+
 //	if (depthPhaseCount(origin)) {
 //		origin->depthType = Origin::DepthPhases;
 //		return true;
@@ -4404,11 +5100,19 @@ bool Autoloc3::_depthIsResolvable(Autoloc::DataModel::Origin *origin)
 	    origin->dep != _config.defaultDepth)
 		origin->depthType = Origin::DepthFree;
 
-	OriginPtr test = new Origin(*origin);
+	// Relocate with free depth and at the configured scan depths
+	// in one go. If the relocations are performed concurrently,
+	// the default depth is included right away, as it may be
+	// needed below.
+	std::vector<double> depths(_config.depthScanDepths);
+	if (_relocatorPool.size() > 1)
+		depths.push_back(_config.defaultDepth);
+	DepthScan scan;
+	_depthScan(origin, depths, scan);
+
 	_relocator.useFixedDepth(false);
-	test->depthType = Origin::DepthFree;
-	LOG_RELOCATOR_CALL;
-	OriginPtr relo = _relocator.relocate(test.get());
+	const DepthScan::Sample *freeDepth = scan.freeDepth();
+	OriginPtr relo = freeDepth ? freeDepth->relo : nullptr;
 	if (relo) {
 #ifdef EXTRA_DEBUGGING
 		SEISCOMP_DEBUG(
@@ -4452,11 +5156,18 @@ bool Autoloc3::_depthIsResolvable(Autoloc::DataModel::Origin *origin)
 	SEISCOMP_DEBUG("_depthIsResolvable using old criterion now");
 #endif
 
-	test = new Origin(*origin);
-	test->dep = _config.defaultDepth;
 	_relocator.useFixedDepth(true);
-	LOG_RELOCATOR_CALL;
-	relo = _relocator.relocate(test.get());
+	const DepthScan::Sample *def = scan.fixedDepth(_config.defaultDepth);
+	if (def)
+		relo = def->relo;
+	else {
+		OriginPtr test = new Origin(*origin);
+		test->dep = _config.defaultDepth;
+		LOG_RELOCATOR_CALL;
+		relo = _relocatorPool.relocate(
+			RelocationRequest{test.get(), true, _config.defaultDepth,
+					  RelocationStatistics::Depth});
+	}
 	if ( ! relo) {
 		// if we fail to relocate using a fixed shallow depth, we
 		// assume that the original depth is resolved.
@@ -4498,6 +5209,36 @@ bool Autoloc3::_depthIsResolvable(Autoloc::DataModel::Origin *origin)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Autoloc3::_depthScan(
+	const Autoloc::DataModel::Origin *origin,
+	const std::vector<double> &depths,
+	DepthScan &scan)
+{
+	LOG_RELOCATOR_CALL;
+	_relocatorPool.depthScan(origin, depths, true, scan);
+
+	// log the misfit as function of depth
+	for (const DepthScan::Sample &sample : scan.samples) {
+		if ( ! sample.relo) {
+			SEISCOMP_DEBUG(
+				"Depth scan origin %ld  %-5s  dep=%6.1f  failed",
+				origin->id, sample.fixedDepth ? "fixed" : "free",
+				sample.depth);
+			continue;
+		}
+		SEISCOMP_DEBUG(
+			"Depth scan origin %ld  %-5s  dep=%6.1f  rms=%5.2f  "
+			"score=%5.1f", origin->id,
+			sample.fixedDepth ? "fixed" : "free", sample.depth,
+			sample.relo->rms(), _score(sample.relo.get()));
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void Autoloc3::sync(const Seiscomp::Core::Time &sctime)
 {
@@ -31,6 +31,7 @@
 #include <seiscomp/autoloc/nucleator.h>
 #include <seiscomp/autoloc/associator.h>
 #include <seiscomp/autoloc/locator.h>
+#include <seiscomp/autoloc/expiry.h>
 #include <seiscomp/autoloc/stationconfig.h>
 
 namespace Seiscomp {
@@ -113,6 +114,14 @@ class Autoloc3 {
 		void setProcessingEnabled(bool yesno=true);
 		bool isProcessingEnabled() const;
 
+		// Between beginBatch() and endBatch() picks and amplitudes
+		// are only stored. The picks are then processed as a group
+		// by endBatch(), which returns true if that resulted in a
+		// new or updated result.
+		void beginBatch();
+		bool endBatch();
+		bool isBatching() const { return _batching; }
+
 		// Return true if the origin is trusted in the sense that we
 		// want to use this origin in the processing. In other words
 		// is must be either
@@ -154,8 +163,11 @@ class Autoloc3 {
 
 		// Feed a PickGroup and try to get something out of it.
 		//
-		// This feeds all the picks in the PickGroup atomically.
-		// TODO: NOT IMPLEMENTED YET
+		// This feeds all the picks in the PickGroup atomically:
+		// All picks are stored first, then associated as a batch.
+		// Each affected origin is reworked only once and all
+		// remaining picks go through one nucleation pass, which
+		// may result in several new origins.
 		bool feed(const Autoloc::DataModel::PickGroup&);
 
 		// Feed a trusted origin.
@@ -226,6 +238,17 @@ class Autoloc3 {
 		// Return true if this is a pick that requires amplitudes
 		bool _requiresAmplitude(const Autoloc::DataModel::Pick*) const;
 
+		// Check whether a pooled pick can be processed and set the
+		// pick attributes needed for processing. Returns the pick
+		// from the pool or NULL if it is not to be processed.
+		const Autoloc::DataModel::Pick *_preparePick(
+			const Autoloc::DataModel::Pick*, bool isnew);
+
+		// The pick filters of _process(). Returns true if the pick
+		// is to be processed further. Otherwise accepted tells
+		// whether the pick was nevertheless accepted.
+		bool _screen(const Autoloc::DataModel::Pick*, bool &accepted);
+
 		// Process the pick. Involves trying to associate with an
 		// existing origin and -upon failure- nucleate a new one.
 		bool _process(const Autoloc::DataModel::Pick*);
@@ -233,6 +256,10 @@ class Autoloc3 {
 		bool _processImportedOrigin(Autoloc::DataModel::Origin*);
 		bool _processManualOrigin(Autoloc::DataModel::Origin*);
 
+		// Process a trusted origin passively, i.e. keep it locked
+		// and only associate picks without relocating.
+		bool _processPassiveOrigin(Autoloc::DataModel::Origin*);
+
 		// _processImportedOrigin + _processManualOrigin
 		bool _processQualifiedOrigin(Autoloc::DataModel::Origin*);
 
@@ -241,8 +268,18 @@ class Autoloc3 {
 		Autoloc::DataModel::OriginPtr _xxlPreliminaryOrigin(
 			const Autoloc::DataModel::Pick*);
 
+		// Add a newly set up station to the lists of neighbouring
+		// stations within xxlMaxStaDist
+		void _xxlSetupStation(const Autoloc::DataModel::Station*);
+
+		// Add a pick newly flagged as XXL to the recent XXL picks
+		// of its station
+		void _xxlAddPick(const Autoloc::DataModel::Pick*);
+
 		// Try to enhance the score by removing each pick
-		// and relocating.
+		// and relocating. At most autoloc.enhanceScore.maxTrials
+		// picks with the largest residuals are tried per loop,
+		// within the time budget autoloc.enhanceScore.timeBudget.
 		//
 		// Returns true if the score could be enhanced.
 		bool _enhanceScore(Autoloc::DataModel::Origin*, size_t maxloops=0);
@@ -307,12 +344,25 @@ class Autoloc3 {
 		Autoloc::DataModel::OriginPtr _tryNucleate(
 			const Autoloc::DataModel::Pick*);
 
+		// Select the best of the candidate origins from the
+		// nucleator and merge it with an equivalent origin, if any.
+		//
+		// Returns either an updated origin or NULL.
+		Autoloc::DataModel::OriginPtr _bestCandidate(
+			const Autoloc::DataModel::OriginVector &candidates);
+
 		// Try to associate one pick to an existing origin
 		//
 		// Returns either an updated origin or NULL.
 		Autoloc::DataModel::OriginPtr _tryAssociate(
 			const Autoloc::DataModel::Pick*);
 
+		// Copy of the origin to associate a pick to. While a
+		// PickGroup is fed, this is a copy of the working copy
+		// of that origin, if there is one.
+		Autoloc::DataModel::OriginPtr _associationCopy(
+			const Autoloc::DataModel::Origin*) const;
+
 		// Try to generate a new origins using XXL picks.
 		//
 		// Returns either a new origin or NULL.
@@ -381,6 +431,21 @@ class Autoloc3 {
 		// * false if not.
 		bool _depthIsResolvable(Autoloc::DataModel::Origin*);
 
+		// Log the relocation statistics per call site. This is
+		// done after each cleanup and at shutdown.
+		void _dumpRelocationStatistics() const;
+
+		// Release a limited number of picks, origins and grid point
+		// entries older than minTime. Called with every fed object.
+		void _expire(Autoloc::DataModel::Time minTime);
+
+		// Relocate with free depth and at the given fixed depths
+		// using the locator pool and log the misfit vs. depth.
+		void _depthScan(
+			const Autoloc::DataModel::Origin*,
+			const std::vector<double> &depths,
+			DepthScan &scan);
+
 		bool _setTheRightDepth(Autoloc::DataModel::Origin*);
 
 		// Determine whether the epicenter location requires the
@@ -435,6 +500,17 @@ class Autoloc3 {
 			const Autoloc::DataModel::Origin*,
 			const Autoloc::DataModel::Origin*);
 
+		// Merge the origins stored during the current feed() of
+		// picks with equivalent existing origins, if enabled. Each
+		// origin takes part in at most one merge. Returns the
+		// number of merges.
+		//
+		// Amplitudes are covered as they feed their pick again.
+		// It is not called for fed origins, as these are stored
+		// as imported, manual or locked origins, which are never
+		// merged.
+		int _mergeEquivalentOrigins();
+
 		bool _associated(const Autoloc::DataModel::Pick*) const;
 
 
@@ -475,26 +551,46 @@ class Autoloc3 {
 		GridSearch _nucleator;
 		Locator    _relocator;
 
-		// origins waiting for a _flush()
-		// TODO: int -> Autoloc::DataModel::OriginID
-		std::map<int, Autoloc::DataModel::Time>      _nextDue;
-		std::map<int, Autoloc::DataModel::OriginPtr> _lastSent;
-		std::map<int, Autoloc::DataModel::OriginPtr> _outgoing;
+		// for independent relocations, e.g. in _enhanceScore()
+		LocatorPool _relocatorPool;
 
 		Autoloc::DataModel::Time _now;
 		Autoloc::DataModel::Time _nextCleanup;
 
+		// picks and origins by time for incremental cleanup
+		Autoloc::ExpiryQueue<Autoloc::DataModel::PickCPtr> _pickExpiry;
+		Autoloc::ExpiryQueue<Autoloc::DataModel::OriginID> _originExpiry;
+
+		// picks by time for releasing their SC picks
+		Autoloc::ExpiryQueue<Autoloc::DataModel::PickCPtr> _scPickExpiry;
+
+		// memory for transient objects while processing a pick
+		Autoloc::Arena _arena;
+
 		Autoloc::DataModel::PickPool pickPool;
 
 		Autoloc::DataModel::StationMap _stations;
+		Autoloc::DataModel::StationRegistry _stationRegistry;
+
+		// For the XXL feature, indexed by station handle: one
+		// Station object per handle, the handles of the stations
+		// within xxlMaxStaDist and the recent XXL picks. This
+		// saves scanning the whole pick pool for XXL picks.
+		std::vector<Autoloc::DataModel::StationCPtr> _xxlStations;
+		std::vector< std::vector<Autoloc::DataModel::Station::Handle> > _xxlNeighbours;
+		std::vector< std::vector<Autoloc::DataModel::PickCPtr> > _xxlPicks;
+
 		// a list of NET.STA strings for missing stations
 		// FIXME: review!
 		std::set<std::string> _missingStations;
 
-		Autoloc::DataModel::OriginVector _origins;
+		// all origins along with their publication state
+		Autoloc::DataModel::OriginRegistry _origins;
 		// origins that were created/modified during the last
 		// feed() call
 		Autoloc::DataModel::OriginVector _newOrigins;
+		// the working copies by origin ID while a PickGroup is fed
+		const std::map<Autoloc::DataModel::OriginID, Autoloc::DataModel::OriginPtr> *_workingOrigins{nullptr};
 
 		Autoloc::StationConfig _stationConfig;
 
@@ -511,6 +607,10 @@ class Autoloc3 {
 
 		bool processingEnabled;
 
+		// picks collected between beginBatch() and endBatch()
+		bool _batching;
+		Autoloc::DataModel::PickGroup _batch;
+
 		// We normally ignore picks from disabled stations. However, in
 		// case of specially qualified origins it might make sense to
 		// add an exception.
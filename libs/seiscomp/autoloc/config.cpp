@@ -53,6 +53,26 @@ void Config::dump() const
 	SEISCOMP_INFO("  maxDepth                         %.1f km", maxDepth);
 //	SEISCOMP_INFO("  minStaCountIgnorePKP             %d",     minStaCountIgnorePKP);
 	SEISCOMP_INFO("  pickKeep                         %.0f s", maxAge);
+	SEISCOMP_INFO("  cleanupStepSize                  %d",     cleanupStepSize);
+	SEISCOMP_INFO("  scPickKeep                       %.0f s", scPickKeep);
+	SEISCOMP_INFO("  associatorThreads                %d",     associatorThreads);
+	SEISCOMP_INFO("  locatorPoolSize                  %d",     locatorPoolSize);
+	SEISCOMP_INFO("  relocationCacheSize              %d",     relocationCacheSize);
+	SEISCOMP_INFO("  secondPassMaxShift               %g km",  secondPassMaxShift);
+	SEISCOMP_INFO("  secondPassMaxTimeShift           %g s",   secondPassMaxTimeShift);
+	SEISCOMP_INFO("  secondPassMaxRMSChange           %g s",   secondPassMaxRMSChange);
+	SEISCOMP_INFO("  preLocatorMaxRMS                 %g s",   preLocatorMaxRMS);
+	SEISCOMP_INFO("  enhanceScoreMaxTrials            %d",     enhanceScoreMaxTrials);
+	SEISCOMP_INFO("  enhanceScoreTimeBudget           %g s",   enhanceScoreTimeBudget);
+	SEISCOMP_INFO("  depthScanDepths");
+	for (double depth : depthScanDepths)
+		SEISCOMP_INFO("                                   %g km",  depth);
+	SEISCOMP_INFO("  mergeEnable                      %s",     mergeEnable ? "true":"false");
+	SEISCOMP_INFO("  mergeMaxTimeDiff                 %g s",   mergeMaxTimeDiff);
+	SEISCOMP_INFO("  mergeMaxDist                     %g deg", mergeMaxDist);
+	SEISCOMP_INFO("  batchMaxDelay                    %g s",   batchMaxDelay);
+	SEISCOMP_INFO("  batchMaxSize                     %d",     batchMaxSize);
+	SEISCOMP_INFO("  batchMinRate                     %g /s",  batchMinRate);
 	SEISCOMP_INFO("  publicationIntervalTimeSlope     %.2f",   publicationIntervalTimeSlope);
 	SEISCOMP_INFO("  publicationIntervalTimeIntercept %.1f",   publicationIntervalTimeIntercept);
 	SEISCOMP_INFO("  publicationIntervalPickCount     %d",     publicationIntervalPickCount);
@@ -65,6 +85,7 @@ void Config::dump() const
 	SEISCOMP_INFO("  playback                         %s",     playback ? "true":"false");
 	SEISCOMP_INFO("  useManualPicks                   %s",     useManualPicks ? "true":"false");
 	SEISCOMP_INFO("  useManualOrigins                 %s",     useManualOrigins ? "true":"false");
+	SEISCOMP_INFO("  passiveManualOrigins             %s",     passiveManualOrigins ? "true":"false");
 	SEISCOMP_INFO("  useImportedOrigins               %s",     useImportedOrigins ? "true":"false");
 	SEISCOMP_INFO("  adoptImportedOriginDepth         %s",     adoptImportedOriginDepth ? "true":"false");
 	SEISCOMP_INFO("  locatorProfile                   %s",     locatorProfile.c_str());
@@ -186,6 +186,83 @@ class Config {
 
 		double cleanupInterval{3600};
 
+		// Maximum number of picks, origins and grid points that
+		// are checked for expiry per fed object. Old objects are
+		// thus released in small steps rather than in one sweep
+		// per cleanupInterval.
+		int cleanupStepSize{100};
+
+		// Time after which the SC pick of an unassociated pick
+		// is released, with respect to pick time. The pick itself
+		// is kept for maxAge. 0 means the SC pick is kept as long
+		// as the pick. Picks without SC pick are no longer
+		// associated or used for nucleation, as the locator
+		// needs the SC pick.
+		double scPickKeep{0};
+
+		// Number of threads used by the associator to match
+		// picks against an origin. Only use > 1 if the
+		// travel-time interface is thread-safe.
+		int associatorThreads{1};
+
+		// Number of locator instances used to relocate
+		// candidate origins and tentative pick exclusions
+		// concurrently. Currently limited to 1, as the SC
+		// object handling of the relocation is not
+		// thread-safe.
+		int locatorPoolSize{1};
+
+		// Maximum number of relocation results kept per locator
+		// instance for reuse by identical relocations. 0 disables
+		// the relocation cache.
+		int relocationCacheSize{1000};
+
+		// A relocation invokes LocSAT a second time unless the
+		// first result differs from its input by less than
+		// these tolerances (km, s, s). A value <= 0 always
+		// enforces the second invocation, which is the default.
+		double secondPassMaxShift{0.};
+		double secondPassMaxTimeShift{0.};
+		double secondPassMaxRMSChange{0.};
+
+		// Maximum number of arrivals, those with the largest
+		// residuals first, tentatively excluded in one
+		// iteration of _enhanceScore(). 0 disables it.
+		int enhanceScoreMaxTrials{5};
+
+		// Wall-clock time budget in seconds of _enhanceScore()
+		// for one origin. 0 means unlimited. Note that a
+		// budget makes results depend on the machine load.
+		double enhanceScoreTimeBudget{0.};
+
+		// Fixed depths in km at which origins are relocated, in
+		// addition to free depth, when testing the depth
+		// resolution. The resulting misfit vs. depth is logged.
+		std::vector<double> depthScanDepths;
+
+		// Maximum RMS in seconds of the linearized pre-location
+		// used by the nucleator to screen candidate origins
+		// before relocating them. 0 disables the screening.
+		double preLocatorMaxRMS{0.};
+
+		// Merge origins updated by a fed pick or amplitude with
+		// existing origins of the same event. Candidates share at
+		// least three picks or are within mergeMaxTimeDiff seconds
+		// and mergeMaxDist degrees. The merged origin is kept only
+		// if it scores at least as high as both origins.
+		bool   mergeEnable{false};
+		double mergeMaxTimeDiff{20.};
+		double mergeMaxDist{1.};
+
+		// Micro-batching of the input. While more than
+		// batchMinRate objects per second are received, picks
+		// and amplitudes are collected for up to batchMaxDelay
+		// seconds or batchMaxSize objects and then processed as
+		// one group. 0 for batchMaxDelay disables batching.
+		double batchMaxDelay{0.};
+		int    batchMaxSize{100};
+		double batchMinRate{20.};
+
 		double publicationIntervalTimeSlope{0.5};
 		double publicationIntervalTimeIntercept{0.};
 		int    publicationIntervalPickCount{20};
@@ -222,6 +299,11 @@ class Config {
 		bool aggressivePKP{true};
 		bool reportAllPhases{false};
 		bool useManualOrigins{false};
+
+		// If true, manual origins are processed passively, i.e.
+		// they are kept fixed and picks are only associated
+		// without relocating.
+		bool passiveManualOrigins{false};
 //		bool adoptManualOriginsFixedDepth{true};
 		bool useImportedOrigins{false};
 		bool adoptImportedOriginDepth{false};
@@ -22,6 +22,8 @@
 #include <iostream>
 #include <algorithm>
 #include <set>
+#include <functional>
+#include <atomic>
 #include <seiscomp/math/mean.h>
 #include <seiscomp/datamodel/inventory.h>
 
@@ -62,13 +64,31 @@ Station::Station(const Seiscomp::DataModel::Station *scstation) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Station::Handle
+StationRegistry::handle(const std::string &net, const std::string &sta)
+{
+	HandleMap &handles = _handles[net];
+	HandleMap::const_iterator it = handles.find(sta);
+	if (it != handles.end())
+		return it->second;
+
+	Station::Handle h = Station::Handle(_count++);
+	handles[sta] = h;
+	return h;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // counter used for debugging
 static int _pickCount=0;
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Pick::Pick(const Seiscomp::DataModel::Pick *scpick)
-	: scpick(scpick), time(scpick->time().value())
+	: time(scpick->time().value()), scpick(scpick)
 {
 //	time = Autoloc::DataModel::Time(scpick->time().value());
 	status = Autoloc::status(scpick);
@@ -76,12 +96,23 @@ Pick::Pick(const Seiscomp::DataModel::Pick *scpick)
 	creationTime = Autoloc::DataModel::Time(
 				scpick->creationInfo().creationTime());
 
+	const Seiscomp::DataModel::WaveformStreamID &wfid =
+		scpick->waveformID();
+	_id  = scpick->publicID();
+	_net = wfid.networkCode();
+	_sta = wfid.stationCode();
+	_loc = wfid.locationCode();
+	_cha = wfid.channelCode();
+	_methodID = scpick->methodID();
+
 	amp = snr = per = 0;
 	xxl = false;
+	hasAmplitudeSNR = false;
 	blacklisted = false;
 	priority = 0;
 	_station = nullptr;
 	_originID = 0;
+	_poolHandle = UINT32_MAX;
 
 	_pickCount++;
 }
@@ -124,7 +155,7 @@ void Pick::setStation(const Station *sta) const
 void Pick::setAmplitudeSNR(const Seiscomp::DataModel::Amplitude *scampl)
 {
 	snr = scampl->amplitude().value();
-	scamplSNR = scampl;
+	hasAmplitudeSNR = true;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -140,7 +171,6 @@ void Pick::setAmplitudeAbs(const Seiscomp::DataModel::Amplitude *scampl)
 //			"setAmplitudeAbs: amp=%g <= 0 publicID=%s",
 //			amp, scampl->publicID().c_str());
 	per = (scampl->type() == "mb") ? scampl->period().value() : 1;
-	scamplAbs = scampl;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -167,6 +197,16 @@ void Pick::setOriginID(OriginID originID) const
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Pick::releaseSCPick() const
+{
+	scpick = nullptr;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Arrival::Arrival()
 	: origin(nullptr), pick(nullptr), residual(0)
@@ -242,12 +282,231 @@ bool operator<(const Arrival& a, const Arrival& b) {
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool ArrivalVector::sort()
 {
-	std::sort(begin(),end());
+	// Sorted arrivals are left untouched, as the write access
+	// would copy storage shared with other vectors.
+	if (std::is_sorted(_data->cbegin(), _data->cend()))
+		return false;
+
+	Storage &data = _detach();
+	std::sort(data.begin(), data.end());
 	return false;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
 
+
+
+static std::atomic<size_t> _arrivalsShared(0);
+static std::atomic<size_t> _arrivalsDetached(0);
+static std::atomic<uint64_t> _arrivalsRevision(0);
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+ArrivalVector::ArrivalVector()
+	: _data(std::make_shared<Storage>()), _revision(++_arrivalsRevision)
+{
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+ArrivalVector::ArrivalVector(const ArrivalVector &other)
+	: _data(other._data), _revision(other._revision),
+	  _statistics(std::atomic_load(&other._statistics)),
+	  _sortedOrder(std::atomic_load(&other._sortedOrder))
+{
+	_arrivalsShared++;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+ArrivalVector &ArrivalVector::operator=(const ArrivalVector &other)
+{
+	if (_data != other._data) {
+		_data = other._data;
+		_revision = other._revision;
+		std::atomic_store(
+			&_statistics, std::atomic_load(&other._statistics));
+		std::atomic_store(
+			&_sortedOrder, std::atomic_load(&other._sortedOrder));
+		_arrivalsShared++;
+	}
+	return *this;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void ArrivalVector::clear()
+{
+	_invalidate();
+
+	if (_data.use_count() > 1)
+		_data = std::make_shared<Storage>();
+	else
+		_data->clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+ArrivalVector::Storage &ArrivalVector::_detach()
+{
+	// Any non-const access may modify the arrivals
+	_invalidate();
+
+	if (_data.use_count() > 1) {
+		_data = std::make_shared<Storage>(*_data);
+		_arrivalsDetached++;
+	}
+	return *_data;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void ArrivalVector::_invalidate()
+{
+	_revision = ++_arrivalsRevision;
+	std::atomic_store(
+		&_statistics, std::shared_ptr<const ArrivalStatistics>());
+	std::atomic_store(
+		&_sortedOrder, std::shared_ptr<const Order>());
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+std::shared_ptr<const ArrivalVector::Order> ArrivalVector::sortedOrder() const
+{
+	std::shared_ptr<const Order> cached = std::atomic_load(&_sortedOrder);
+	if (cached)
+		return cached;
+
+	const Storage &data = *_data;
+	std::shared_ptr<Order> order = std::make_shared<Order>(data.size());
+	for (size_type i=0; i<data.size(); i++)
+		(*order)[i] = i;
+
+	// Equivalent arrivals remain in their original order
+	std::sort(order->begin(), order->end(),
+		[&data](size_type a, size_type b) {
+			if (data[a] < data[b]) return true;
+			if (data[b] < data[a]) return false;
+			return a < b;
+		});
+
+	cached = order;
+	std::atomic_store(&_sortedOrder, cached);
+	return cached;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+static bool lessStation(const Pick *a, const Pick *b)
+{
+	if (a->net() != b->net()) return a->net() < b->net();
+	if (a->sta() != b->sta()) return a->sta() < b->sta();
+	return a->loc() < b->loc();
+}
+
+
+static bool sameStation(const Pick *a, const Pick *b)
+{
+	return a->net() == b->net() && a->sta() == b->sta() &&
+	       a->loc() == b->loc();
+}
+
+
+static int countStations(std::vector<const Pick*> &picks)
+{
+	std::sort(picks.begin(), picks.end(), lessStation);
+	return std::unique(picks.begin(), picks.end(), sameStation)
+		- picks.begin();
+}
+
+
+ArrivalStatistics ArrivalVector::statistics() const
+{
+	std::shared_ptr<const ArrivalStatistics>
+		cached = std::atomic_load(&_statistics);
+	if (cached)
+		return *cached;
+
+	std::shared_ptr<ArrivalStatistics>
+		stats = std::make_shared<ArrivalStatistics>();
+
+	std::vector<double> residuals, distances;
+	std::vector<const Pick*> associated, defining;
+
+	for (const Arrival &arr : *_data) {
+		if (arr.pick) {
+			associated.push_back(arr.pick.get());
+			if ( ! arr.excluded)
+				defining.push_back(arr.pick.get());
+		}
+
+		if ( ! arr.excluded || arr.phase == "PKP")
+			stats->phaseCount++;
+
+		if (arr.excluded)
+			continue;
+
+		stats->definingPhaseCount++;
+		residuals.push_back(arr.residual);
+		distances.push_back(arr.distance);
+	}
+
+	stats->associatedStationCount = countStations(associated);
+	stats->definingStationCount = countStations(defining);
+	stats->rms = Seiscomp::Math::Statistics::rms(residuals);
+	if (distances.size() > 0)
+		stats->medianStationDistance =
+			Seiscomp::Math::Statistics::median(distances);
+
+	std::atomic_store(
+		&_statistics,
+		std::shared_ptr<const ArrivalStatistics>(stats));
+	return *stats;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+size_t ArrivalVector::sharedCount()
+{
+	return _arrivalsShared;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+size_t ArrivalVector::detachedCount()
+{
+	return _arrivalsDetached;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
 // static unsigned long _i = 1;
 
 static int _originCount = 0;
@@ -274,7 +533,8 @@ Origin::Origin(double lat, double lon, double dep, const Time &time)
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Origin::Origin(const Origin &other)
-	: Hypocenter(other.lat, other.lon, other.dep), time(other.time)
+	: Hypocenter(other.lat, other.lon, other.dep), time(other.time),
+	  arrivals(other.arrivals)
 {
 //	updateFrom(&other);
 	id = other.id;
@@ -291,7 +551,6 @@ Origin::Origin(const Origin &other)
 	time = other.time;
 	timestamp = other.timestamp;
 	depthType = other.depthType;
-	arrivals = other.arrivals;
 	quality = other.quality;
 	error = other.error;
 	referenceOrigin = other.referenceOrigin;
@@ -392,27 +651,10 @@ bool Origin::adopt(const Pick *pick) const
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 int Origin::phaseCount(double dmin, double dmax) const
 {
-	int count = 0;
-
-	for (ArrivalVector::const_iterator
-		it = arrivals.begin(); it != arrivals.end(); ++it) {
-		const Arrival &arr = *it;
-
-		if (dmin==0. && dmax==180.) {
-			double delta, az, baz;
-			delazi(this, arr.pick->station(), delta, az, baz);
-			if (delta < dmin || delta > dmax)
-				continue;
-		}
-
-		if (arr.excluded && arr.phase != "PKP")
-			continue;
-
-		count++;
-
-	}
-
-	return count;
+	// NOTE: The distance range is not applied here, which has
+	// always been the case. Therefore the cached count is valid
+	// for any range.
+	return arrivals.statistics().phaseCount;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -422,6 +664,9 @@ int Origin::phaseCount(double dmin, double dmax) const
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 int Origin::definingPhaseCount(double dmin, double dmax) const
 {
+	if (dmin==0. && dmax==180.)
+		return arrivals.statistics().definingPhaseCount;
+
 	int count = 0;
 
 	for (ArrivalVector::const_iterator
@@ -451,22 +696,7 @@ int Origin::definingPhaseCount(double dmin, double dmax) const
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 int Origin::associatedStationCount() const {
-	std::set<std::string> stations;
-
-	for (ArrivalVector::const_iterator
-		it = arrivals.begin(); it != arrivals.end(); ++it) {
-		const Arrival &arr = *it;
-
-		if ( ! arr.pick )
-			continue;
-
-		const std::string key =
-			arr.pick->net() + "." + arr.pick->sta() + "." +
-			arr.pick->loc();
-		stations.insert(key);
-	}
-
-	return stations.size();
+	return arrivals.statistics().associatedStationCount;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -475,25 +705,7 @@ int Origin::associatedStationCount() const {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 int Origin::definingStationCount() const {
-	std::set<std::string> stations;
-
-	for (ArrivalVector::const_iterator
-		it = arrivals.begin(); it != arrivals.end(); ++it) {
-		const Arrival &arr = *it;
-
-		if (arr.excluded)
-			continue;
-
-		if ( ! arr.pick )
-			continue;
-
-		const std::string key =
-			arr.pick->net() + "." + arr.pick->sta() + "." +
-			arr.pick->loc();
-		stations.insert(key);
-	}
-
-	return stations.size();
+	return arrivals.statistics().definingStationCount;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -507,14 +719,7 @@ double Origin::rms() const
 	// no meaning, no matter if the origin has arrivals or not.
 	if (imported) return 0;
 
-	int arrivalCount = arrivals.size();
-	std::vector<double> res;
-	for(int i=0; i<arrivalCount; i++) {
-		if ( ! arrivals[i].excluded)
-			res.push_back(arrivals[i].residual);
-	}
-
-	return Seiscomp::Math::Statistics::rms(res);
+	return arrivals.statistics().rms;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -524,18 +729,7 @@ double Origin::rms() const
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 double Origin::medianStationDistance() const
 {
-	int arrivalCount = arrivals.size();
-	std::vector<double> distance;
-
-	for(int i=0; i<arrivalCount; i++) {
-		if ( ! arrivals[i].excluded)
-			distance.push_back(arrivals[i].distance);
-	}
-
-	if (distance.size() == 0)
-		return -1;
-
-	return Seiscomp::Math::Statistics::median(distance);
+	return arrivals.statistics().medianStationDistance;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -587,16 +781,6 @@ void Origin::geoProperties(double &min, double &max, double &gap) const
 
 
 
-// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-int OriginVector::mergeEquivalentOrigins(const Origin *start)
-{
-	return 0;
-}
-// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
-
-
-
-
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool OriginVector::find(const Origin *origin) const
 {
@@ -640,20 +824,30 @@ const Origin* OriginVector::find(const OriginID &id) const
 
 
 
-// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-static int countCommonPicks(const Origin *origin1, const Origin *origin2)
+// Origins sharing at least this many picks within this time difference
+// possibly belong to the same event
+static const size_t minCommonPickCount = 3;
+static const double maxCommonPickTimeDiff = 1500;
+
+// width of the time buckets of the origin registry in seconds
+static const double timeBucketWidth = 60;
+
+static long timeBucket(Time time)
 {
-	int commonPickCount = 0;
-	int arrivalCount1 = origin1->arrivals.size();
-	int arrivalCount2 = origin2->arrivals.size();
+	return long(floor(time/timeBucketWidth));
+}
 
-	for(int i1=0; i1 < arrivalCount1; i1++) {
-		for(int i2=0; i2<arrivalCount2; i2++)
-			if (origin1->arrivals[i1].pick == origin2->arrivals[i2].pick)
-				commonPickCount++;
-	}
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool OriginRegistry::add(Origin *origin)
+{
+	Record &rec = _records[origin->id];
+	if (rec.origin)
+		return false;
 
-	return commonPickCount;
+	rec.origin = origin;
+	_origins.push_back(origin);
+	_index(origin);
+	return true;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -661,30 +855,25 @@ static int countCommonPicks(const Origin *origin1, const Origin *origin2)
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-const Origin *OriginVector::bestEquivalentOrigin(const Origin *origin) const
+Origin* OriginRegistry::find(const OriginID &id)
 {
-	const Origin *best = 0;
-	int maxCommonPickCount = 0;
-
-	for (const_iterator it=begin(); it != end(); ++it) {
-
-		const double max_dt = 1500;
-		const Origin* this_origin = (*it).get();
+	RecordMap::iterator it = _records.find(id);
+	if (it == _records.end())
+		return nullptr;
+	return it->second.origin.get();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
-		if (std::abs(this_origin->time - origin->time) > max_dt)
-			continue;
 
-		int commonPickCount = countCommonPicks(origin, this_origin);
-		if (commonPickCount<3)
-			continue; // FIXME: hackish
 
-		if (commonPickCount > maxCommonPickCount) {
-			maxCommonPickCount = commonPickCount;
-			best = this_origin;
-		}
-	}
 
-	return best;
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const Origin* OriginRegistry::find(const OriginID &id) const
+{
+	RecordMap::const_iterator it = _records.find(id);
+	if (it == _records.end())
+		return nullptr;
+	return it->second.origin.get();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -692,14 +881,12 @@ const Origin *OriginVector::bestEquivalentOrigin(const Origin *origin) const
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-bool automatic(const Pick *pick)
+OriginRegistry::Record* OriginRegistry::record(const OriginID &id)
 {
-	switch(pick->status) {
-	case Pick::Manual:
-		return false;
-	}
-
-	return true;
+	RecordMap::iterator it = _records.find(id);
+	if (it == _records.end())
+		return nullptr;
+	return &it->second;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -707,10 +894,12 @@ bool automatic(const Pick *pick)
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-bool ignored(const Pick *pick)
+const OriginRegistry::Record* OriginRegistry::record(const OriginID &id) const
 {
-	// TODO: Review. We only need one criterion.
-	return pick->status == Pick::IgnoredAutomatic || pick->blacklisted;
+	RecordMap::const_iterator it = _records.find(id);
+	if (it == _records.end())
+		return nullptr;
+	return &it->second;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -718,9 +907,9 @@ bool ignored(const Pick *pick)
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-bool manual(const Pick *pick)
+OriginRegistry::Record& OriginRegistry::touch(const OriginID &id)
 {
-	return ! automatic(pick);
+	return _records[id];
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -728,9 +917,9 @@ bool manual(const Pick *pick)
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-char statusFlag(const Pick *pick)
+void OriginRegistry::setModified(const OriginID &id)
 {
-	return automatic(pick) ? 'A' : 'M';
+	_modified.insert(id);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -738,16 +927,721 @@ char statusFlag(const Pick *pick)
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-bool hasAmplitude(const Pick *pick)
+size_t OriginRegistry::removeOlderThan(const Time &minTime)
 {
-	if (pick->amp <= 0)
-		return false;
+	size_t count = 0;
 
-	return true;
+	for (RecordMap::iterator it = _records.begin(); it != _records.end(); ) {
+		const Record &rec = it->second;
+
+		// A record without a live origin is judged by the
+		// published version.
+		const Origin *origin = rec.origin ? rec.origin.get() :
+			rec.lastSent ? rec.lastSent.get() : rec.outgoing.get();
+
+		if (origin == nullptr || origin->time < minTime) {
+			it = _records.erase(it);
+			count++;
+		}
+		else
+			++it;
+	}
+
+	OriginVector tmp;
+	for (const OriginPtr &origin : _origins) {
+		if (origin->time < minTime) {
+			_unindex(origin->id);
+			continue;
+		}
+		tmp.push_back(origin);
+	}
+	_origins.swap(tmp);
+
+	return count;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
 
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+size_t OriginRegistry::remove(const std::vector<OriginID> &ids)
+{
+	size_t count = 0;
+	for (const OriginID &id : ids)
+		count += _records.erase(id);
+
+	if (count == 0)
+		return 0;
+
+	OriginVector tmp;
+	for (const OriginPtr &origin : _origins) {
+		if (_records.find(origin->id) == _records.end()) {
+			_unindex(origin->id);
+			continue;
+		}
+		tmp.push_back(origin);
+	}
+	_origins.swap(tmp);
+
+	return count;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OriginRegistry::clear()
+{
+	_origins.clear();
+	_records.clear();
+	_pickIndex._clear();
+	_indexed.clear();
+	_timeIndex.clear();
+	_modified.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const OriginRegistry::PickIndex &OriginRegistry::pickIndex() const
+{
+	if (_modified.empty())
+		return _pickIndex;
+
+	// The time is compared, too, as an origin may have been moved
+	// in time without modifying its arrivals.
+	for (OriginID id : _modified) {
+		const Origin *origin = find(id);
+		if (origin == nullptr)
+			// removed meanwhile and thus no longer indexed
+			continue;
+
+		auto it = _indexed.find(id);
+		if (it != _indexed.end() &&
+		    it->second.revision == origin->arrivals.revision() &&
+		    it->second.time == origin->time)
+			continue;
+
+		_unindex(id);
+		_index(origin);
+	}
+	_modified.clear();
+
+	return _pickIndex;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OriginRegistry::_index(const Origin *origin) const
+{
+	Indexed &indexed = _indexed[origin->id];
+	indexed.revision = origin->arrivals.revision();
+	indexed.picks.clear();
+	indexed.time = origin->time;
+	_timeIndex[timeBucket(origin->time)].push_back(origin->id);
+
+	size_t arrivalCount = origin->arrivals.size();
+	for (size_t i=0; i<arrivalCount; i++) {
+		const Pick *pick = origin->arrivals[i].pick.get();
+		_pickIndex._add(pick, ArrivalRef{origin->id, i});
+		indexed.picks.push_back(pick);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OriginRegistry::_unindex(OriginID id) const
+{
+	auto it = _indexed.find(id);
+	if (it == _indexed.end())
+		return;
+
+	for (const Pick *pick : it->second.picks)
+		_pickIndex._remove(pick, id);
+
+	auto tit = _timeIndex.find(timeBucket(it->second.time));
+	if (tit != _timeIndex.end()) {
+		std::vector<OriginID> &ids = tit->second;
+		ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+		if (ids.empty())
+			_timeIndex.erase(tit);
+	}
+
+	_indexed.erase(it);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const OriginRegistry::ArrivalRefs *
+OriginRegistry::PickIndex::find(const Pick *pick) const
+{
+	uint32_t handle = pick->poolHandle();
+	if (handle < _entries.size() && _entries[handle].pick == pick)
+		return &_entries[handle].refs;
+
+	if (_others.empty())
+		return nullptr;
+	auto it = _others.find(pick);
+	if (it == _others.end())
+		return nullptr;
+	return &it->second;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OriginRegistry::PickIndex::_add(const Pick *pick, const ArrivalRef &ref)
+{
+	uint32_t handle = pick->poolHandle();
+	if (handle < _entries.size() && _entries[handle].pick == pick) {
+		_entries[handle].refs.push_back(ref);
+		return;
+	}
+
+	// The pick may already be in _others if its entry was taken
+	// when it was added first.
+	if (handle != UINT32_MAX &&
+	    (handle >= _entries.size() || _entries[handle].pick == nullptr) &&
+	    (_others.empty() || _others.find(pick) == _others.end())) {
+		if (handle >= _entries.size())
+			_entries.resize(handle+1, Entry{nullptr, ArrivalRefs()});
+		_entries[handle].pick = pick;
+		_entries[handle].refs.push_back(ref);
+		return;
+	}
+
+	_others[pick].push_back(ref);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OriginRegistry::PickIndex::_remove(const Pick *pick, OriginID id)
+{
+	auto referencedBy = [id](const ArrivalRef &ref) {
+		return ref.originID == id;
+	};
+
+	uint32_t handle = pick->poolHandle();
+	if (handle < _entries.size() && _entries[handle].pick == pick) {
+		Entry &entry = _entries[handle];
+		entry.refs.erase(
+			std::remove_if(entry.refs.begin(), entry.refs.end(), referencedBy),
+			entry.refs.end());
+		if (entry.refs.empty())
+			entry.pick = nullptr;
+		return;
+	}
+
+	auto it = _others.find(pick);
+	if (it == _others.end())
+		// pick referenced twice and already removed
+		return;
+
+	ArrivalRefs &refs = it->second;
+	refs.erase(
+		std::remove_if(refs.begin(), refs.end(), referencedBy),
+		refs.end());
+	if (refs.empty())
+		_others.erase(it);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OriginRegistry::PickIndex::_clear()
+{
+	_entries.clear();
+	_others.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int OriginRegistry::PickIndex::findArrival(OriginID id, const Pick *pick) const
+{
+	const ArrivalRefs *refs = find(pick);
+	if (refs == nullptr)
+		return -1;
+
+	for (const ArrivalRef &ref : *refs) {
+		if (ref.originID == id)
+			return int(ref.index);
+	}
+
+	return -1;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+std::unordered_map<OriginID, size_t>
+OriginRegistry::PickIndex::commonPickCounts(const Origin *origin) const
+{
+	std::unordered_map<OriginID, size_t> counts;
+
+	for (const Arrival &arr : origin->arrivals) {
+		const ArrivalRefs *refs = find(arr.pick.get());
+		if (refs == nullptr)
+			continue;
+		for (const ArrivalRef &ref : *refs)
+			counts[ref.originID]++;
+	}
+
+	return counts;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const Origin *OriginRegistry::bestEquivalentOrigin(const Origin *origin) const
+{
+	std::unordered_map<OriginID, size_t> counts =
+		pickIndex().commonPickCounts(origin);
+	if (counts.empty())
+		return nullptr;
+
+	const Origin *best = nullptr;
+	size_t maxCommonPickCount = 0;
+
+	// in order of insertion, like OriginVector::bestEquivalentOrigin()
+	for (const OriginPtr &other : _origins) {
+		auto it = counts.find(other->id);
+		if (it == counts.end())
+			continue;
+
+		if (std::abs(other->time - origin->time) > maxCommonPickTimeDiff)
+			continue;
+
+		size_t commonPickCount = it->second;
+		if (commonPickCount < minCommonPickCount)
+			continue; // FIXME: hackish
+
+		if (commonPickCount > maxCommonPickCount) {
+			maxCommonPickCount = commonPickCount;
+			best = other.get();
+		}
+	}
+
+	return best;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+std::vector<OriginID> OriginRegistry::equivalentOrigins(
+	const Origin *origin, double maxTimeDiff, double maxDist) const
+{
+	std::vector<OriginID> ids;
+
+	const PickIndex &index = pickIndex();
+	for (const auto &item : index.commonPickCounts(origin)) {
+		if (item.second < minCommonPickCount)
+			continue;
+
+		const Origin *other = find(item.first);
+		if (other == nullptr ||
+		    std::abs(other->time - origin->time) > maxCommonPickTimeDiff)
+			continue;
+
+		ids.push_back(item.first);
+	}
+
+	// The buckets were brought up to date with the origin times
+	// by pickIndex() above.
+	if (maxTimeDiff > 0) {
+		long last = timeBucket(origin->time + maxTimeDiff);
+		for (auto it = _timeIndex.lower_bound(timeBucket(origin->time - maxTimeDiff));
+		     it != _timeIndex.end() && it->first <= last; ++it) {
+			for (OriginID id : it->second) {
+				const Origin *other = find(id);
+				if (other == nullptr ||
+				    std::abs(other->time - origin->time) > maxTimeDiff)
+					continue;
+
+				double delta, az, baz;
+				Autoloc::delazi(
+					origin->lat, origin->lon,
+					other->lat, other->lon, delta, az, baz);
+				if (delta > maxDist)
+					continue;
+
+				ids.push_back(id);
+			}
+		}
+	}
+
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	ids.erase(std::remove(ids.begin(), ids.end(), origin->id), ids.end());
+
+	return ids;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+static std::vector<const Pick*> sortedPicks(const Origin *origin)
+{
+	std::vector<const Pick*> picks;
+	picks.reserve(origin->arrivals.size());
+	for (const Arrival &arr : origin->arrivals)
+		picks.push_back(arr.pick.get());
+	std::sort(picks.begin(), picks.end());
+	return picks;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+static int countCommonPicks(const Origin *origin1, const Origin *origin2)
+{
+	// Merge the sorted picks. Like comparing all pairs of arrivals,
+	// a pick referenced twice by both origins counts four times.
+	std::vector<const Pick*> picks1 = sortedPicks(origin1);
+	std::vector<const Pick*> picks2 = sortedPicks(origin2);
+
+	int commonPickCount = 0;
+	size_t i1 = 0, i2 = 0;
+	while (i1 < picks1.size() && i2 < picks2.size()) {
+		if (picks1[i1] < picks2[i2])
+			i1++;
+		else if (picks2[i2] < picks1[i1])
+			i2++;
+		else {
+			const Pick *pick = picks1[i1];
+			int n1 = 0, n2 = 0;
+			for ( ; i1 < picks1.size() && picks1[i1] == pick; i1++)
+				n1++;
+			for ( ; i2 < picks2.size() && picks2[i2] == pick; i2++)
+				n2++;
+			commonPickCount += n1*n2;
+		}
+	}
+
+	return commonPickCount;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const Origin *OriginVector::bestEquivalentOrigin(const Origin *origin) const
+{
+	const Origin *best = 0;
+	int maxCommonPickCount = 0;
+
+	for (const_iterator it=begin(); it != end(); ++it) {
+
+		const double max_dt = 1500;
+		const Origin* this_origin = (*it).get();
+
+		if (std::abs(this_origin->time - origin->time) > max_dt)
+			continue;
+
+		int commonPickCount = countCommonPicks(origin, this_origin);
+		if (commonPickCount<3)
+			continue; // FIXME: hackish
+
+		if (commonPickCount > maxCommonPickCount) {
+			maxCommonPickCount = commonPickCount;
+			best = this_origin;
+		}
+	}
+
+	return best;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool automatic(const Pick *pick)
+{
+	switch(pick->status) {
+	case Pick::Manual:
+		return false;
+	}
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool ignored(const Pick *pick)
+{
+	// TODO: Review. We only need one criterion.
+	return pick->status == Pick::IgnoredAutomatic || pick->blacklisted;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool manual(const Pick *pick)
+{
+	return ! automatic(pick);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+char statusFlag(const Pick *pick)
+{
+	return automatic(pick) ? 'A' : 'M';
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool hasAmplitude(const Pick *pick)
+{
+	if (pick->amp <= 0)
+		return false;
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+PickPool::PickPool()
+{
+	clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PickPool::clear()
+{
+	_slots.assign(1024, Empty);
+	_usedSlots = 0;
+	_picks.clear();
+	_size = 0;
+	_order.clear();
+	_inserted.clear();
+	_erased.clear();
+	_freeHandles.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+size_t PickPool::_slot(const std::string &id) const
+{
+	// linear probing
+	size_t mask = _slots.size()-1;
+	size_t slot = std::hash<std::string>()(id) & mask;
+	size_t firstDeleted = _slots.size();
+
+	while (true) {
+		Handle handle = _slots[slot];
+		if (handle == Empty)
+			// reuse a Deleted slot passed on the way
+			return firstDeleted < _slots.size() ? firstDeleted : slot;
+		if (handle == Deleted) {
+			if (firstDeleted == _slots.size())
+				firstDeleted = slot;
+		}
+		else if (_picks[handle]->id() == id)
+			return slot;
+		slot = (slot+1) & mask;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PickPool::_rehash(size_t slotCount)
+{
+	_slots.assign(slotCount, Empty);
+	_usedSlots = 0;
+
+	size_t mask = slotCount-1;
+	for (Handle handle=0; handle<_picks.size(); handle++) {
+		if ( ! _picks[handle])
+			continue;
+		size_t slot = std::hash<std::string>()(_picks[handle]->id()) & mask;
+		while (_slots[slot] != Empty)
+			slot = (slot+1) & mask;
+		_slots[slot] = handle;
+		_usedSlots++;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PickPool::_updateOrder() const
+{
+	if (_inserted.empty() && _erased.empty())
+		return;
+
+	auto erased = [this](Handle handle) { return ! _picks[handle]; };
+	auto idLess = [this](Handle a, Handle b) {
+		return _picks[a]->id() < _picks[b]->id();
+	};
+
+	_order.erase(
+		std::remove_if(_order.begin(), _order.end(), erased),
+		_order.end());
+	_inserted.erase(
+		std::remove_if(_inserted.begin(), _inserted.end(), erased),
+		_inserted.end());
+
+	// usually only a few picks were inserted since
+	std::sort(_inserted.begin(), _inserted.end(), idLess);
+	size_t middle = _order.size();
+	_order.insert(_order.end(), _inserted.begin(), _inserted.end());
+	std::inplace_merge(
+		_order.begin(), _order.begin()+middle, _order.end(), idLess);
+	_inserted.clear();
+
+	// no longer referenced by the order
+	_freeHandles.insert(_freeHandles.end(), _erased.begin(), _erased.end());
+	_erased.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+PickPool::Handle PickPool::insert(const Pick *pick)
+{
+	// Keep the load including Deleted slots below 1/2. If that
+	// is mostly due to Deleted slots, rehashing at the same size
+	// is sufficient.
+	if (2*(_usedSlots+1) > _slots.size())
+		_rehash(4*(_size+1) > _slots.size() ? 2*_slots.size() : _slots.size());
+
+	size_t slot = _slot(pick->id());
+	Handle handle = _slots[slot];
+	if (handle != Empty && handle != Deleted)
+		return handle; // already in the pool
+
+	// Reuse the erased handles once they are as many as the picks,
+	// so that updating the order is amortized.
+	if (_freeHandles.empty() && _erased.size() > _size)
+		_updateOrder();
+
+	if (_freeHandles.empty()) {
+		handle = Handle(_picks.size());
+		_picks.push_back(pick);
+	}
+	else {
+		handle = _freeHandles.back();
+		_freeHandles.pop_back();
+		_picks[handle] = pick;
+	}
+
+	if (_slots[slot] == Empty)
+		_usedSlots++;
+	_slots[slot] = handle;
+	_size++;
+	_inserted.push_back(handle);
+	pick->setPoolHandle(handle);
+
+	return handle;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+PickPool::Handle PickPool::find(const std::string &id) const
+{
+	Handle handle = _slots[_slot(id)];
+	if (handle == Empty || handle == Deleted)
+		return InvalidHandle;
+	return handle;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const Pick *PickPool::get(const std::string &id) const
+{
+	return get(find(id));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool PickPool::erase(Handle handle)
+{
+	if (handle >= _picks.size() || ! _picks[handle])
+		return false;
+
+	size_t slot = _slot(_picks[handle]->id());
+	_slots[slot] = Deleted;
+
+	_picks[handle] = nullptr;
+	_erased.push_back(handle);
+	_size--;
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 }  // namespace DataModel
 }  // namespace Autoloc
 }  // namespace Seiscomp
@@ -15,8 +15,12 @@
 #define SEISCOMP_LIBAUTOLOC_DATAMODEL_H_INCLUDED
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <list>
 #include <vector>
+#include <cstdint>
+#include <memory>
 
 #include <seiscomp/core/baseobject.h>
 #include <seiscomp/datamodel/station.h>
@@ -38,9 +42,15 @@ DEFINE_SMARTPOINTER(Station);
 
 class Station : public Seiscomp::Core::BaseObject {
 
+	public:
+		// Dense integer identifying NET.STA, see StationRegistry
+		typedef uint32_t Handle;
+		static const Handle InvalidHandle = ~Handle(0);
+
 	public:
 		Station(const Seiscomp::DataModel::Station*);
 
+		Handle handle{InvalidHandle};
 		std::string code, net;
 		std::string loc; // to be used in the future
 		double lat, lon, alt;
@@ -60,6 +70,22 @@ class Station : public Seiscomp::Core::BaseObject {
 typedef std::map<std::string, StationCPtr> StationMap;
 
 
+// Assigns dense handles 0, 1, 2, ... to stations at setup time. All
+// location codes of a station share one handle. Containers indexed
+// by handle replace maps keyed by "NET.STA" strings, which had to be
+// built for every lookup.
+class StationRegistry {
+	public:
+		// The handle of NET.STA, assigned if not yet known
+		Station::Handle handle(const std::string &net, const std::string &sta);
+
+	private:
+		typedef std::map<std::string, Station::Handle> HandleMap;
+		std::map<std::string, HandleMap> _handles;
+		size_t _count{0};
+};
+
+
 DEFINE_SMARTPOINTER(Origin);
 class Origin;
 
@@ -84,29 +110,28 @@ class Pick : public Seiscomp::Core::BaseObject {
 
 		static int count();
 
-		// Attached SC objects. The pick must never be null.
-		Seiscomp::DataModel::PickCPtr      scpick;
-		Seiscomp::DataModel::AmplitudeCPtr scamplAbs;
-		Seiscomp::DataModel::AmplitudeCPtr scamplSNR;
-
 		const std::string& id() const {
-			return scpick->publicID();
+			return _id;
 		}
 
 		const std::string& net() const {
-			return scpick->waveformID().networkCode();
+			return _net;
 		}
 
 		const std::string& sta() const {
-			return scpick->waveformID().stationCode();
+			return _sta;
 		}
 
 		const std::string& loc() const {
-			return scpick->waveformID().locationCode();
+			return _loc;
 		}
 
 		const std::string& cha() const {
-			return scpick->waveformID().channelCode();
+			return _cha;
+		}
+
+		const std::string& methodID() const {
+			return _methodID;
 		}
 
 		const Station *station() const {
@@ -115,7 +140,8 @@ class Pick : public Seiscomp::Core::BaseObject {
 
 		void setStation(const Station *sta) const;
 
-		// sets the amplitude to either the SNR or absolute amplitude
+		// Sets the amplitude to either the SNR or absolute
+		// amplitude. Only the values are kept, not the SC objects.
 		void setAmplitudeSNR(const Seiscomp::DataModel::Amplitude*);
 		void setAmplitudeAbs(const Seiscomp::DataModel::Amplitude*);
 
@@ -123,6 +149,26 @@ class Pick : public Seiscomp::Core::BaseObject {
 		OriginID originID() const;
 		void setOriginID(OriginID originID) const;
 
+		// Release the SC pick. All attributes used by Autoloc are
+		// kept, but the SC pick is needed by the locator.
+		void releaseSCPick() const;
+
+		// The handle of the pick in the pick pool, UINT32_MAX if
+		// it was never inserted. It is kept after the pick was
+		// erased from the pool, which is relied upon by the pick
+		// index of the OriginRegistry. Autoloc inserts each pick
+		// once only.
+		uint32_t poolHandle() const {
+			return _poolHandle;
+		}
+
+		void setPoolHandle(uint32_t handle) const {
+			_poolHandle = handle;
+		}
+
+	public:
+		// The attributes used by the algorithms come first, so
+		// that scanning picks touches as little memory as possible.
 		Time time;	// pick time
 		float amp;	// linear amplitude
 		float per;	// period in seconds
@@ -131,8 +177,7 @@ class Pick : public Seiscomp::Core::BaseObject {
 
 		Status status;
 		bool xxl;	// Does it look like a pick of a very big event?
-		Time creationTime;
-
+		bool hasAmplitudeSNR;
 		mutable bool blacklisted;
 		mutable int priority;
 
@@ -141,8 +186,20 @@ class Pick : public Seiscomp::Core::BaseObject {
 //		mutable OriginPtr _origin;
 		mutable OriginID _originID;
 
+		mutable uint32_t _poolHandle;
+
 		// Station information
 		mutable StationPtr _station;
+
+	public:
+		Time creationTime;
+
+		// The attached SC pick, null if released
+		mutable Seiscomp::DataModel::PickCPtr scpick;
+
+	private:
+		std::string _id, _net, _sta, _loc, _cha;
+		std::string _methodID;
 };
 
 
@@ -213,9 +270,95 @@ class Arrival {
 };
 
 
-class ArrivalVector : public std::vector<Arrival> {
+// Statistics of the arrivals of an origin, computed in one pass
+class ArrivalStatistics {
 	public:
+		int phaseCount{0};
+		int definingPhaseCount{0};
+		int associatedStationCount{0};
+		int definingStationCount{0};
+		double rms{0};
+		// negative if there are no defining arrivals
+		double medianStationDistance{-1};
+};
+
+
+// The arrivals of an origin. Copies share the arrival storage until
+// one of them is modified (copy-on-write), so that a copy of an
+// origin, e.g. a tentative one, is cheap as long as its arrivals are
+// not changed. Arrivals are only modified through push_back(), set(),
+// setExcluded(), erase() and the like.
+//
+// The statistics are cached until the next modification. Like the
+// storage, the cached statistics are shared by copies.
+//
+// Note that references obtained by read access may become invalid
+// by any subsequent modification.
+class ArrivalVector {
+	public:
+		typedef std::vector<Arrival> Storage;
+		typedef Storage::value_type value_type;
+		typedef Storage::size_type size_type;
+		typedef Storage::const_iterator const_iterator;
+		typedef std::vector<size_type> Order;
+
+	public:
+		ArrivalVector();
+		ArrivalVector(const ArrivalVector &other);
+		ArrivalVector &operator=(const ArrivalVector &other);
+
+		size_type size() const { return _data->size(); }
+		bool empty() const { return _data->empty(); }
+
+		// Only read access is provided, as any write access
+		// copies storage shared with other vectors. Arrivals
+		// are modified through the explicit setters below.
+		const_iterator begin() const { return _data->cbegin(); }
+		const_iterator end() const { return _data->cend(); }
+		const Arrival &operator[](size_type i) const { return (*_data)[i]; }
+
+		void push_back(const Arrival &arr) { _detach().push_back(arr); }
+		void set(size_type i, const Arrival &arr) { _detach()[i] = arr; }
+		void erase(size_type i) {
+			Storage &data = _detach();
+			data.erase(data.begin() + i);
+		}
+		void clear();
+
+		void setExcluded(size_type i, Arrival::ExcludeReason reason) {
+			_detach()[i].excluded = reason;
+		}
+
 		bool sort();
+
+		ArrivalStatistics statistics() const;
+
+		// Indices of the arrivals sorted by distance and pick
+		// time. Like the statistics, the order is cached until
+		// the next modification.
+		std::shared_ptr<const Order> sortedOrder() const;
+
+		// Identifies the content. Vectors with the same revision
+		// have the same arrivals. Any modification assigns a new
+		// revision, larger than all previous ones.
+		uint64_t revision() const { return _revision; }
+
+		// Number of copies sharing the storage and of actual
+		// copies of the storage since startup
+		static size_t sharedCount();
+		static size_t detachedCount();
+
+	private:
+		Storage &_detach();
+		void _invalidate();
+
+	private:
+		std::shared_ptr<Storage> _data;
+		uint64_t _revision;
+		// Set and read atomically, as const origins may be
+		// queried from several threads, e.g. by the locator pool
+		mutable std::shared_ptr<const ArrivalStatistics> _statistics;
+		mutable std::shared_ptr<const Order> _sortedOrder;
 };
 
 
@@ -307,6 +450,9 @@ class Origin : public Hypocenter {
 		int findArrival(const Pick *pick) const;
 
 		// Count the defining phases, optionally within a distance range
+		//
+		// These statistics are cached with the arrivals, see
+		// ArrivalVector.
 		int phaseCount(double dmin=0., double dmax=180.) const;
 		int definingPhaseCount(double dmin=0., double dmax=180.) const;
 
@@ -375,10 +521,166 @@ class OriginVector : public std::vector<OriginPtr> {
 		// Try to find the best Origin which possibly belongs to the
 		// same event
 		const Origin *bestEquivalentOrigin(const Origin *start) const;
+};
+
+
+// The origins known to Autoloc, in order of insertion, indexed by
+// origin ID. Along with each origin, the registry holds its
+// publication state, so that all per-origin state is found in O(1)
+// and removed in one step.
+class OriginRegistry {
+	public:
+		class Record {
+			public:
+				// the live origin, null if not (or no longer) stored
+				OriginPtr origin;
+				// the version waiting to be published, if any
+				OriginPtr outgoing;
+				// a copy of the version published last, if any
+				OriginPtr lastSent;
+				// earliest time at which the next version is due
+				Time nextDue{0};
+		};
+
+		typedef std::unordered_map<OriginID, Record> RecordMap;
+		typedef OriginVector::const_iterator const_iterator;
+
+		// An arrival of a registered origin
+		class ArrivalRef {
+			public:
+				OriginID originID;
+				// index of the arrival in the origin
+				size_t index;
+		};
+		typedef std::vector<ArrivalRef> ArrivalRefs;
+
+		// The arrivals of all registered origins by pick. This
+		// replaces scanning the arrivals of every origin to find
+		// out which origins reference a pick.
+		class PickIndex {
+			public:
+				// The arrivals referencing the pick,
+				// NULL if there are none
+				const ArrivalRefs *find(const Pick *pick) const;
+
+				// Index of the arrival of the origin
+				// referencing the pick or -1 if not found,
+				// like Origin::findArrival()
+				int findArrival(OriginID id, const Pick *pick) const;
+
+				// For all registered origins sharing picks
+				// with the given origin, the number of common
+				// picks by origin ID
+				std::unordered_map<OriginID, size_t>
+				commonPickCounts(const Origin *origin) const;
+
+			private:
+				friend class OriginRegistry;
+
+				struct Entry {
+					const Pick *pick;
+					ArrivalRefs refs;
+				};
+
+				void _add(const Pick *pick, const ArrivalRef &ref);
+				void _remove(const Pick *pick, OriginID id);
+				void _clear();
+
+				// Indexed by the pool handle of the pick. An
+				// erased pick still referenced by origins keeps
+				// its entry, so a pick reusing its handle goes
+				// to _others, as do picks without a handle.
+				std::vector<Entry> _entries;
+				std::unordered_map<const Pick*, ArrivalRefs> _others;
+		};
+
+	public:
+		// Add the origin to the registry. Returns false if an origin
+		// with the same ID is already registered.
+		bool add(Origin*);
+
+		// Return origin with the origin ID if found, NULL otherwise
+		Origin *find(const OriginID &id);
+		const Origin *find(const OriginID &id) const;
+
+		// Return the record for the origin ID, NULL if not found
+		Record *record(const OriginID &id);
+		const Record *record(const OriginID &id) const;
+
+		// Return the record for the origin ID, created if needed
+		Record &touch(const OriginID &id);
+
+		const RecordMap &records() const { return _records; }
+
+		// Mark the registered origin as modified in place, e.g.
+		// by Origin::updateFrom(), so that the next pickIndex()
+		// indexes it again
+		void setModified(const OriginID &id);
+
+		// Remove origins older than minTime together with all their
+		// state. Returns the number of removed records.
+		size_t removeOlderThan(const Time &minTime);
+
+		// Remove the origins with these IDs together with all their
+		// state. This is a single pass over the origins. Returns the
+		// number of removed records.
+		size_t remove(const std::vector<OriginID> &ids);
+
+		void clear();
+
+		// The registered origins in order of insertion
+		const OriginVector &origins() const { return _origins; }
+
+		const_iterator begin() const { return _origins.begin(); }
+		const_iterator end() const { return _origins.end(); }
+		size_t size() const { return _origins.size(); }
+
+		// The pick index, brought up to date with the origins.
+		// Only the origins passed to setModified() since the last
+		// call are checked and indexed again if their arrivals
+		// or time differ from the indexed state. Without any
+		// such origin, the index is returned as is. The returned
+		// index remains valid until the arrivals of a registered
+		// origin are modified.
+		const PickIndex &pickIndex() const;
+
+		// Try to find the best Origin which possibly belongs to the
+		// same event, see OriginVector::bestEquivalentOrigin()
+		const Origin *bestEquivalentOrigin(const Origin *start) const;
+
+		// The IDs of all registered origins which possibly belong
+		// to the same event as the given origin, in ascending
+		// order. These either share picks with the origin, like
+		// bestEquivalentOrigin(), or are within maxTimeDiff
+		// seconds and maxDist degrees of it. The origin itself
+		// is not included.
+		std::vector<OriginID> equivalentOrigins(
+			const Origin *origin,
+			double maxTimeDiff, double maxDist) const;
+
+	private:
+		// the indexed state of an origin
+		class Indexed {
+			public:
+				uint64_t revision{0};
+				std::vector<const Pick*> picks;
+				Time time{0};
+		};
+
+		void _index(const Origin *origin) const;
+		void _unindex(OriginID id) const;
 
-		// Try to find Origins which possibly belong to the same
-		// event and try to merge the picks
-		int mergeEquivalentOrigins(const Origin *start=0);
+	private:
+		OriginVector _origins;
+		RecordMap _records;
+
+		mutable PickIndex _pickIndex;
+		mutable std::unordered_map<OriginID, Indexed> _indexed;
+		// origin IDs in buckets of origin time, kept up to date
+		// together with the pick index
+		mutable std::map<long, std::vector<OriginID> > _timeIndex;
+		// origins modified since the last pickIndex()
+		mutable std::unordered_set<OriginID> _modified;
 };
 
 
@@ -394,9 +696,107 @@ class Event : public Seiscomp::Core::BaseObject {
 */
 
 
-typedef std::map<std::string, Autoloc::DataModel::PickCPtr> PickPool;
+// The picks known to Autoloc, accessed by ID in O(1) through an open
+// addressing hash table. Each pick is assigned an integer handle when
+// inserted, which remains valid until the pick is removed and is also
+// stored in the pick. Handles of removed picks are reused.
+//
+// Iteration yields PickCPtr in alphabetical order of the pick IDs, the
+// order in which picks have always been processed.
+class PickPool {
+	public:
+		typedef uint32_t Handle;
+		static constexpr Handle InvalidHandle = UINT32_MAX;
+
+	private:
+		typedef std::vector<Handle> Order;
+
+	public:
+		// Iterates in order of the pick IDs. Erasing picks does
+		// not invalidate it, inserting picks may.
+		class const_iterator {
+			public:
+				const_iterator(const PickPool *pool, Order::const_iterator it)
+					: _pool(pool), _it(it) {}
+
+				const PickCPtr &operator*() const { return _pool->_picks[*_it]; }
+				const PickCPtr *operator->() const { return &_pool->_picks[*_it]; }
+				const_iterator &operator++() { ++_it; return *this; }
+				bool operator==(const const_iterator &other) const { return _it == other._it; }
+				bool operator!=(const const_iterator &other) const { return _it != other._it; }
+
+				Handle handle() const { return *_it; }
+
+			private:
+				const PickPool *_pool;
+				Order::const_iterator _it;
+		};
+
+	public:
+		PickPool();
+
+		// Insert a pick unless a pick with the same ID is present
+		// and set its pool handle. Returns the handle of the pick
+		// with that ID.
+		Handle insert(const Pick *pick);
+
+		// InvalidHandle if not found
+		Handle find(const std::string &id) const;
+
+		// NULL if not found
+		const Pick *get(const std::string &id) const;
+		const Pick *get(Handle handle) const {
+			return handle < _picks.size() ? _picks[handle].get() : nullptr;
+		}
+
+		bool erase(Handle handle);
+		void clear();
+
+		size_t size() const { return _size; }
+
+		// The order of the pick IDs is only brought up to date here,
+		// so insert() and erase() do not compare IDs. A pick erased
+		// during the iteration is visited as NULL.
+		const_iterator begin() const {
+			_updateOrder();
+			return const_iterator(this, _order.begin());
+		}
+		const_iterator end() const {
+			_updateOrder();
+			return const_iterator(this, _order.end());
+		}
+
+	private:
+		// marks unused and previously used table slots
+		static constexpr Handle Empty   = UINT32_MAX;
+		static constexpr Handle Deleted = UINT32_MAX-1;
+
+		// slot of the pick with this ID or of the Empty slot
+		// where it would have to be inserted
+		size_t _slot(const std::string &id) const;
+		void _rehash(size_t slotCount);
+		void _updateOrder() const;
+
+	private:
+		// the table of handles, its size being a power of 2
+		std::vector<Handle> _slots;
+		size_t _usedSlots; // including Deleted
+
+		// the picks indexed by handle
+		std::vector<PickCPtr> _picks;
+		size_t _size;
+
+		// The handles in order of the pick IDs and those inserted
+		// since the last update of the order. The erased handles
+		// are only reused once they are removed from the order.
+		mutable Order _order;
+		mutable Order _inserted;
+		mutable std::vector<Handle> _erased;
+		mutable std::vector<Handle> _freeHandles;
+};
+
 typedef std::vector<PickPtr> PickVector;
-typedef std::vector<Pick*>   PickGroup;
+typedef std::vector<const Pick*> PickGroup;
 
 
 
@@ -0,0 +1,92 @@
+/***************************************************************************
+ * Copyright (C) GFZ Potsdam                                               *
+ * All rights reserved.                                                    *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_LIBAUTOLOC_EXPIRY_H_INCLUDED
+#define SEISCOMP_LIBAUTOLOC_EXPIRY_H_INCLUDED
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+namespace Seiscomp {
+
+namespace Autoloc {
+
+
+// Items to be released after some time, kept in lists of fixed time
+// width. Expiring items only touches the oldest lists, so releasing
+// old objects can be spread over many small steps instead of sweeping
+// all objects at once.
+//
+// An item is only released once its whole list is older than the
+// expiry time. Items are thus released up to one bucket width late,
+// but never early.
+template <typename T>
+class ExpiryQueue {
+	public:
+		ExpiryQueue(double bucketWidth=60.) : _width(bucketWidth), _size(0) {}
+
+		void push(double time, const T &item) {
+			long index = long(std::floor(time/_width));
+			_buckets[index].push_back(item);
+			_size++;
+		}
+
+		// Pass at most maxCount items older than minTime to f.
+		// Returns the number of items passed.
+		template <typename F>
+		size_t expire(double minTime, size_t maxCount, F f) {
+			size_t count = 0;
+
+			while (count < maxCount && ! _buckets.empty()) {
+				auto it = _buckets.begin();
+				if ((it->first+1)*_width > minTime)
+					break;
+
+				std::vector<T> &items = it->second;
+				while (count < maxCount && ! items.empty()) {
+					T item = items.back();
+					items.pop_back();
+					_size--;
+					count++;
+					// f may push the item again
+					f(item);
+				}
+
+				if (items.empty())
+					_buckets.erase(it);
+			}
+
+			return count;
+		}
+
+		void clear() {
+			_buckets.clear();
+			_size = 0;
+		}
+
+		size_t size() const { return _size; }
+
+	private:
+		double _width;
+		std::map<long, std::vector<T> > _buckets;
+		size_t _size;
+};
+
+
+}  // namespace Autoloc
+
+}  // namespace Seiscomp
+
+#endif
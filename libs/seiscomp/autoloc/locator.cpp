@@ -19,12 +19,17 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
 
 #include <seiscomp/datamodel/pick.h>
 #include <seiscomp/datamodel/origin.h>
 #include <seiscomp/datamodel/sensorlocation.h>
 #include <seiscomp/autoloc/util.h>
 #include <seiscomp/autoloc/sc3adapters.h>
+#include <seiscomp/autoloc/parallel.h>
 
 
 using namespace std;
@@ -44,15 +49,13 @@ MySensorLocationDelegate::~MySensorLocationDelegate() {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void MySensorLocationDelegate::setStation(const Autoloc::DataModel::Station *station) {
-	std::string key = station->net + "." + station->code;
-
 	Seiscomp::DataModel::SensorLocationPtr
 		sloc = Seiscomp::DataModel::SensorLocation::Create();
 
 	sloc->setLatitude(  station->lat  );
 	sloc->setLongitude( station->lon  );
 	sloc->setElevation( station->alt  );
-	_sensorLocations.insert(std::pair<std::string, Seiscomp::DataModel::SensorLocationPtr>(key, sloc));
+	_sensorLocations[station->net].insert(SensorLocationList::value_type(station->code, sloc));
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -64,10 +67,14 @@ Seiscomp::DataModel::SensorLocation *
 MySensorLocationDelegate::getSensorLocation(Seiscomp::DataModel::Pick *pick) const {
 	if ( !pick ) return NULL;
 
-	std::string key = pick->waveformID().networkCode() + "." + pick->waveformID().stationCode();
+	const Seiscomp::DataModel::WaveformStreamID &wfid = pick->waveformID();
+
+	auto nit = _sensorLocations.find(wfid.networkCode());
+	if ( nit == _sensorLocations.end() )
+		return NULL;
 
-	SensorLocationList::const_iterator it = _sensorLocations.find(key);
-	if ( it != _sensorLocations.end() )
+	SensorLocationList::const_iterator it = nit->second.find(wfid.stationCode());
+	if ( it != nit->second.end() )
 		return it->second.get();
 
 	return NULL;
@@ -82,6 +89,10 @@ Locator::Locator()
 {
 	scconfig = NULL;
 	_locatorCallCounter = 0;
+	_cacheSize = 1000;
+	_cacheHits = _cacheMisses = 0;
+	_secondPassesSkipped = 0;
+	_callSite = RelocationStatistics::Other;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -121,6 +132,14 @@ bool Locator::init()
 	sensorLocationDelegate = new MySensorLocationDelegate;
 	sclocator->setSensorLocationDelegate(sensorLocationDelegate.get());
 
+	_scorigin = Seiscomp::DataModel::Origin::Create();
+	_scorigin->setEvaluationMode(
+		Seiscomp::DataModel::EvaluationMode(
+			Seiscomp::DataModel::AUTOMATIC));
+	_scorigin->setEvaluationStatus(
+		Seiscomp::DataModel::EvaluationStatus(
+			Seiscomp::DataModel::PRELIMINARY));
+
 	return true;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -132,6 +151,14 @@ bool Locator::init()
 Locator::~Locator()
 {
 	SEISCOMP_INFO("Locator instance called %ld times", _locatorCallCounter);
+	if (_cacheHits + _cacheMisses > 0)
+		SEISCOMP_INFO(
+			"Relocation cache hits: %ld  misses: %ld  hit rate: %.1f%%",
+			_cacheHits, _cacheMisses,
+			100.*_cacheHits/(_cacheHits + _cacheMisses));
+	SEISCOMP_INFO(
+		"Second LocSAT invocation skipped %ld times",
+		_secondPassesSkipped);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -192,9 +219,184 @@ void Locator::useFixedDepth(bool use) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Locator::setCacheSize(size_t size) {
+	_cacheSize = size;
+	while (_cache.size() > _cacheSize) {
+		_cacheIndex.erase(_cache.back().key);
+		_cache.pop_back();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Locator::_clearCache() {
+	_cache.clear();
+	_cacheIndex.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Locator::setSecondPassTolerances(const SecondPassTolerances &tolerances) {
+	_secondPassTolerances = tolerances;
+	// the cached results were obtained with other tolerances
+	_clearCache();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+std::string Locator::_cacheKey(const Autoloc::DataModel::Origin *origin) const
+{
+	// Starting hypocenter, quantized well below the precision
+	// of any location, and the depth setting of the locator
+	char buf[200];
+	snprintf(buf, sizeof(buf), "%.4f %.4f %.3f %.3f %d %.3f %.3f|",
+		 origin->lat, origin->lon, origin->dep, double(origin->time),
+		 sclocator->usingFixedDepth() ? 1 : 0,
+		 sclocator->fixedDepth(), _minDepth);
+
+	// The arrivals in a well-defined order
+	std::vector<std::string> arrivals;
+	for (const Autoloc::DataModel::Arrival &arr : origin->arrivals)
+		arrivals.push_back(
+			arr.pick->id() + " " + arr.phase + " " +
+			std::to_string(int(arr.excluded)));
+	std::sort(arrivals.begin(), arrivals.end());
+
+	std::string key = buf;
+	for (const std::string &s : arrivals)
+		key += s + "|";
+
+	return key;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+static bool arrivalOrder(
+	const Autoloc::DataModel::Arrival &a,
+	const Autoloc::DataModel::Arrival &b)
+{
+	if (a.pick->id() != b.pick->id())
+		return a.pick->id() < b.pick->id();
+	if (a.phase != b.phase)
+		return a.phase < b.phase;
+	return a.excluded < b.excluded;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+static std::vector<size_t> sortedArrivalIndices(
+	const Autoloc::DataModel::ArrivalVector &arrivals)
+{
+	std::vector<size_t> indices(arrivals.size());
+	for (size_t i=0; i<indices.size(); i++)
+		indices[i] = i;
+	std::sort(indices.begin(), indices.end(),
+		[&arrivals](size_t i, size_t k) {
+			return arrivalOrder(arrivals[i], arrivals[k]);
+		});
+	return indices;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Autoloc::DataModel::Origin *Locator::_fromCache(
+	const Autoloc::DataModel::Origin *origin,
+	const CacheEntry &entry) const
+{
+	using namespace Autoloc::DataModel;
+
+	const Origin *cached = entry.relo.get();
+
+	// Like in _screlocate() only the attributes set by the
+	// locator are updated in a copy of the origin.
+	Origin *relo = new Origin(*origin);
+	relo->lat     = cached->lat;
+	relo->lon     = cached->lon;
+	relo->dep     = cached->dep;
+	relo->time    = cached->time;
+	relo->laterr  = cached->laterr;
+	relo->lonerr  = cached->lonerr;
+	relo->deperr  = cached->deperr;
+	relo->timeerr = cached->timeerr;
+	relo->methodID     = cached->methodID;
+	relo->earthModelID = cached->earthModelID;
+	relo->error   = cached->error;
+	relo->quality = cached->quality;
+	if (entry.depthMinimum)
+		relo->depthType = Origin::DepthMinimum;
+
+	// The arrival order may differ but the arrivals are the same
+	std::vector<size_t> dst = sortedArrivalIndices(relo->arrivals);
+	std::vector<size_t> src = sortedArrivalIndices(cached->arrivals);
+	for (size_t i=0; i<dst.size(); i++) {
+		Arrival arr = relo->arrivals[dst[i]];
+		const Arrival &carr = cached->arrivals[src[i]];
+		arr.residual = carr.residual;
+		arr.distance = carr.distance;
+		arr.azimuth  = carr.azimuth;
+		arr.phase    = carr.phase;
+		relo->arrivals.set(dst[i], arr);
+	}
+
+	return relo;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void Locator::_cacheStore(
+	const std::string &key,
+	const Autoloc::DataModel::Origin *relo,
+	bool depthMinimum)
+{
+	if (_cacheSize == 0)
+		return;
+
+	CacheEntry entry;
+	entry.key = key;
+	// The caller may modify the result, therefore keep a copy.
+	entry.relo = new Autoloc::DataModel::Origin(*relo);
+	entry.depthMinimum = depthMinimum;
+
+	_cache.push_front(entry);
+	_cacheIndex[key] = _cache.begin();
+
+	while (_cache.size() > _cacheSize) {
+		_cacheIndex.erase(_cache.back().key);
+		_cache.pop_back();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void Locator::setProfile(const std::string &name) {
 	sclocator->setProfile(name);
+	// the cached results were obtained with another profile
+	_clearCache();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -203,6 +405,25 @@ void Locator::setProfile(const std::string &name) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Autoloc::DataModel::Origin *Locator::relocate(const Autoloc::DataModel::Origin *origin)
+{
+	std::chrono::steady_clock::time_point
+		start = std::chrono::steady_clock::now();
+
+	Autoloc::DataModel::Origin *relo = _relocate(origin);
+
+	std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+	_statistics.add(_callSite, relo != NULL, duration.count());
+
+	return relo;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Autoloc::DataModel::Origin *Locator::_relocate(const Autoloc::DataModel::Origin *origin)
 {
 	using namespace Autoloc::DataModel;
 
@@ -221,10 +442,31 @@ Autoloc::DataModel::Origin *Locator::relocate(const Autoloc::DataModel::Origin *
 */
 
 
-	Origin* relo = origin->locked ? nullptr : _screlocate(origin);
+	if (origin->locked)
+		return NULL;
+
+	// Identical relocations are frequent, e.g. during _rework(),
+	// so look for a cached result first.
+	std::string key;
+	if (_cacheSize > 0) {
+		key = _cacheKey(origin);
+		auto it = _cacheIndex.find(key);
+		if (it != _cacheIndex.end()) {
+			_cacheHits++;
+			// move to front
+			_cache.splice(_cache.begin(), _cache, it->second);
+			return _fromCache(origin, _cache.front());
+		}
+		_cacheMisses++;
+	}
+
+	// A failed relocation is not cached, as the failure may be
+	// due to a transient problem.
+	Origin* relo = _screlocate(origin);
 	if (relo == NULL)
 		return NULL;
 
+	bool depthMinimum = false;
 	if (relo->dep <= _minDepth &&
 	    relo->depthType != Origin::DepthManuallyFixed &&
 	    ! sclocator->usingFixedDepth()) {
@@ -239,6 +481,7 @@ Autoloc::DataModel::Origin *Locator::relocate(const Autoloc::DataModel::Origin *
 				delete relo;
 				relo = relo2;
 				relo->depthType = Origin::DepthMinimum;
+				depthMinimum = true;
 			}
 			else {
 				delete relo;
@@ -250,6 +493,8 @@ Autoloc::DataModel::Origin *Locator::relocate(const Autoloc::DataModel::Origin *
 	if ( ! Autoloc::determineAzimuthalGaps(relo, &q.aziGapPrimary, &q.aziGapSecondary))
 		q.aziGapPrimary = q.aziGapSecondary = 360.;
 
+	_cacheStore(key, relo, depthMinimum);
+
 	return relo;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -257,13 +502,92 @@ Autoloc::DataModel::Origin *Locator::relocate(const Autoloc::DataModel::Origin *
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Autoloc::DataModel::Origin *Locator::relocate(
+	const Autoloc::DataModel::Origin *origin,
+	bool fixedDepth, double depth)
+{
+	// Save the current depth setting, which is locator state
+	bool wasFixed = sclocator->usingFixedDepth();
+	double previousDepth = sclocator->fixedDepth();
+
+	setFixedDepth(depth, fixedDepth);
+	Autoloc::DataModel::Origin *relo = relocate(origin);
+
+	// restore previous depth setting
+	setFixedDepth(previousDepth, wasFixed);
+
+	return relo;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool Locator::_needsSecondPass(
+	const Autoloc::DataModel::Origin *input,
+	const Seiscomp::DataModel::Origin *result) const
+{
+	const SecondPassTolerances &tol = _secondPassTolerances;
+
+	if (tol.maxShift <= 0 || tol.maxTimeShift <= 0 || tol.maxRMSChange <= 0)
+		return true;
+
+	// Residuals are inconsistent if LocSAT returned a different
+	// number of arrivals or failed to compute a residual.
+	size_t arrivalCount = input->arrivals.size();
+	if (result->arrivalCount() != arrivalCount)
+		return true;
+
+	std::vector<double> residuals;
+	try {
+		for (size_t i=0; i<arrivalCount; i++) {
+			if (input->arrivals[i].excluded)
+				continue;
+			double residual = result->arrival(i)->timeResidual();
+			if (std::abs(residual) >= 999.)
+				return true;
+			residuals.push_back(residual);
+		}
+
+		double delta, az, baz;
+		Autoloc::delazi(
+			input->lat, input->lon,
+			result->latitude().value(), result->longitude().value(),
+			delta, az, baz);
+		double dz = result->depth().value() - input->dep;
+		double shift = std::sqrt(std::pow(delta*111.195, 2) + dz*dz);
+		if (shift > tol.maxShift)
+			return true;
+
+		double dt = double(result->time().value() - Seiscomp::Core::Time()) - input->time;
+		if (std::abs(dt) > tol.maxTimeShift)
+			return true;
+	}
+	catch ( ... ) {
+		return true;
+	}
+
+	double rms = Seiscomp::Math::Statistics::rms(residuals);
+	if (std::abs(rms - input->rms()) > tol.maxRMSChange)
+		return true;
+
+	return false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 Autoloc::DataModel::Origin* Locator::_screlocate(const Autoloc::DataModel::Origin *origin)
 {
 	// convert origin to SC, relocate, and convert the result back
-
-	Seiscomp::DataModel::OriginPtr scorigin = exportToSC(origin);
-	if ( scorigin==NULL ) {
+	//
+	// Instead of exporting a new SC origin each time, the SC origin
+	// buffer of this locator is updated in place.
+	if ( ! updateSC(origin, _scorigin.get())) {
 		// give up
 		SEISCOMP_ERROR("Unexpected failure to relocate origin");
 		return NULL;
@@ -328,14 +652,24 @@ Autoloc::DataModel::Origin* Locator::_screlocate(const Autoloc::DataModel::Origi
 		// FIXME:
 		// Sometimes LocSAT appears to require a second
 		// invocation to produce a decent result. Reason TBD
+		//
+		// The second invocation is only needed if the first
+		// one hasn't converged, i.e. moved the hypocenter or
+		// changed the RMS significantly.
 		
 		Seiscomp::DataModel::OriginPtr temp;
-		temp = sclocator->relocate(scorigin.get());
+		temp = sclocator->relocate(_scorigin.get());
 		if ( ! temp) // FIXME
 			return NULL;
-		screlo = sclocator->relocate(temp.get());
-		if ( ! screlo) // FIXME
-			return NULL;
+		if (_needsSecondPass(origin, temp.get())) {
+			screlo = sclocator->relocate(temp.get());
+			if ( ! screlo) // FIXME
+				return NULL;
+		}
+		else {
+			screlo = temp;
+			_secondPassesSkipped++;
+		}
 	}
 	catch(Seiscomp::Seismology::LocatorException &) {
 		return NULL;
@@ -409,7 +743,7 @@ Autoloc::DataModel::Origin* Locator::_screlocate(const Autoloc::DataModel::Origi
 	// relo and screlo. This is given but still somewhat error-prone.
 	size_t arrivalCount = origin->arrivals.size();
 	for (size_t i=0; i<arrivalCount; i++) {
-		Autoloc::DataModel::Arrival &arr = relo->arrivals[i];
+		Autoloc::DataModel::Arrival arr = relo->arrivals[i];
 		const std::string &pickID = screlo->arrival(i)->pickID();
 
 		if (arr.pick->id() != pickID) {
@@ -440,6 +774,7 @@ Autoloc::DataModel::Origin* Locator::_screlocate(const Autoloc::DataModel::Origi
 			arr.residual = arr.pick->time - (origin->time + tt.time);
 		}
 */
+		relo->arrivals.set(i, arr);
 	}
 
 	relo->error.sdobs  = 1; // FIXME
@@ -453,6 +788,440 @@ Autoloc::DataModel::Origin* Locator::_screlocate(const Autoloc::DataModel::Origi
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
 
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const char *RelocationStatistics::name(CallSite site)
+{
+	switch (site) {
+		case Other:               return "other";
+		case NucleatorCandidate:  return "nucleator candidate";
+		case NucleatorFinal:      return "nucleator final";
+		case Associate:           return "associate";
+		case Rework:              return "rework";
+		case TrimResiduals:       return "trimResiduals";
+		case EnsureAcceptableRMS: return "ensureAcceptableRMS";
+		case EnhanceScore:        return "enhanceScore";
+		case Depth:               return "depth";
+		case Merge:               return "merge";
+		case XXL:                 return "XXL";
+		case ManualOrigin:        return "manual origin";
+		case ImportedOrigin:      return "imported origin";
+		default:
+			break;
+	}
+	return "unknown";
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+RelocationStatistics::RelocationStatistics()
+{
+	reset();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void RelocationStatistics::reset()
+{
+	for (Site &site : _sites) {
+		site.success = site.failure = 0;
+		site.duration = 0;
+		for (size_t &count : site.bins)
+			count = 0;
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void RelocationStatistics::add(CallSite callSite, bool success, double duration)
+{
+	Site &site = _sites[callSite];
+	if (success)
+		site.success++;
+	else
+		site.failure++;
+	site.duration += duration;
+
+	int bin = 0;
+	if (duration > 1.E-5)
+		bin = int(std::ceil(std::log(duration/1.E-5)/std::log(1.25)));
+	site.bins[std::min(bin, int(BinCount)-1)]++;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void RelocationStatistics::merge(const RelocationStatistics &other)
+{
+	for (int i=0; i<CallSiteCount; i++) {
+		Site &site = _sites[i];
+		const Site &otherSite = other._sites[i];
+		site.success  += otherSite.success;
+		site.failure  += otherSite.failure;
+		site.duration += otherSite.duration;
+		for (int k=0; k<BinCount; k++)
+			site.bins[k] += otherSite.bins[k];
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double RelocationStatistics::_percentile(CallSite callSite, double p) const
+{
+	const Site &site = _sites[callSite];
+	size_t count = site.success + site.failure;
+	size_t cumulative = 0;
+	for (int k=0; k<BinCount; k++) {
+		cumulative += site.bins[k];
+		if (cumulative >= p*count)
+			return 1.E-5*std::pow(1.25, k);
+	}
+	return 1.E-5*std::pow(1.25, BinCount-1);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void RelocationStatistics::dump(const std::string &title) const
+{
+	SEISCOMP_INFO_S("Relocations " + title);
+	SEISCOMP_INFO(
+		"  %-20s %8s %8s %8s %9s %9s %9s %9s",
+		"call site", "calls", "success", "failed",
+		"total/s", "p50/ms", "p95/ms", "p99/ms");
+
+	for (int i=0; i<CallSiteCount; i++) {
+		CallSite callSite = CallSite(i);
+		const Site &site = _sites[i];
+		size_t count = site.success + site.failure;
+		if (count == 0)
+			continue;
+		SEISCOMP_INFO(
+			"  %-20s %8ld %8ld %8ld %9.2f %9.2f %9.2f %9.2f",
+			name(callSite), count, site.success, site.failure,
+			site.duration,
+			1000*_percentile(callSite, 0.50),
+			1000*_percentile(callSite, 0.95),
+			1000*_percentile(callSite, 0.99));
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+LocatorPool::LocatorPool()
+{
+	scconfig = NULL;
+	_minDepth = 5;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+LocatorPool::~LocatorPool()
+{
+	for (Locator *locator: _locators)
+		delete locator;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LocatorPool::setConfig(const Seiscomp::Config::Config *conf) {
+	scconfig = conf;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool LocatorPool::init(size_t size)
+{
+	if (size < 1)
+		size = 1;
+
+	// Each Locator creates SC origins and LocSAT looks up the SC
+	// picks by public ID. Neither may happen in several threads at
+	// once, see _screlocate().
+	if (size > 1) {
+		SEISCOMP_WARNING(
+			"Locator pool size %ld not supported, using 1 because "
+			"the relocation is not thread-safe", size);
+		size = 1;
+	}
+
+	for (Locator *locator: _locators)
+		delete locator;
+	_locators.clear();
+
+	for (size_t i=0; i<size; i++) {
+		Locator *locator = new Locator;
+		locator->setConfig(scconfig);
+		if ( ! locator->init()) {
+			delete locator;
+			return false;
+		}
+		locator->setMinimumDepth(_minDepth);
+		_locators.push_back(locator);
+	}
+
+	SEISCOMP_DEBUG("Locator pool of size %ld", _locators.size());
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+size_t LocatorPool::size() const
+{
+	return _locators.size();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LocatorPool::setProfile(const std::string &name)
+{
+	for (Locator *locator: _locators)
+		locator->setProfile(name);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LocatorPool::setStation(const Autoloc::DataModel::Station *station)
+{
+	// each Locator has its own sensor location delegate
+	for (Locator *locator: _locators)
+		locator->setStation(station);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LocatorPool::setMinimumDepth(double depth)
+{
+	_minDepth = depth;
+	for (Locator *locator: _locators)
+		locator->setMinimumDepth(depth);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LocatorPool::setCacheSize(size_t size)
+{
+	for (Locator *locator: _locators)
+		locator->setCacheSize(size);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LocatorPool::setSecondPassTolerances(const SecondPassTolerances &tolerances)
+{
+	for (Locator *locator: _locators)
+		locator->setSecondPassTolerances(tolerances);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+RelocationStatistics LocatorPool::statistics() const
+{
+	RelocationStatistics statistics;
+	for (const Locator *locator: _locators)
+		statistics.merge(locator->statistics());
+	return statistics;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double LocatorPool::minimumDepth() const
+{
+	return _minDepth;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LocatorPool::relocate(
+	const RelocationRequestVector &requests,
+	Autoloc::DataModel::OriginVector &results)
+{
+	results.clear();
+	results.resize(requests.size());
+
+	// The requests are distributed over the Locator instances in
+	// contiguous shards. Each Locator is used by one thread only.
+	std::vector<Autoloc::DataModel::Origin*> relocated(requests.size(), nullptr);
+
+	parallelFor(requests.size(), _locators.size(),
+		[&](size_t worker, size_t i) {
+			const RelocationRequest &r = requests[i];
+			_locators[worker]->setCallSite(r.callSite);
+			relocated[i] = _locators[worker]->relocate(
+				r.origin, r.fixedDepth, r.depth);
+		});
+
+	// Smart pointers are assigned only here in the calling thread
+	for (size_t i=0; i<requests.size(); i++)
+		results[i] = relocated[i];
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Autoloc::DataModel::Origin *LocatorPool::relocate(
+	const RelocationRequest &request)
+{
+	if (_locators.empty())
+		return NULL;
+
+	_locators[0]->setCallSite(request.callSite);
+	return _locators[0]->relocate(
+		request.origin, request.fixedDepth, request.depth);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void LocatorPool::depthScan(
+	const Autoloc::DataModel::Origin *origin,
+	const std::vector<double> &depths,
+	bool freeDepth, DepthScan &scan,
+	RelocationStatistics::CallSite site)
+{
+	using namespace Autoloc::DataModel;
+
+	std::vector<double> sorted(depths);
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	// One copy per request, with the depth type and starting
+	// depth set according to the request
+	OriginVector copies;
+	RelocationRequestVector requests;
+
+	if (freeDepth) {
+		OriginPtr copy = new Origin(*origin);
+		copy->depthType = Origin::DepthFree;
+		copies.push_back(copy);
+
+		RelocationRequest request;
+		request.origin = copy.get();
+		request.fixedDepth = false;
+		request.depth = 0;
+		request.callSite = site;
+		requests.push_back(request);
+	}
+
+	for (double depth : sorted) {
+		OriginPtr copy = new Origin(*origin);
+		copy->dep = depth;
+		copies.push_back(copy);
+
+		RelocationRequest request;
+		request.origin = copy.get();
+		request.fixedDepth = true;
+		request.depth = depth;
+		request.callSite = site;
+		requests.push_back(request);
+	}
+
+	OriginVector relocated;
+	relocate(requests, relocated);
+
+	scan.samples.clear();
+	for (size_t i=0; i<requests.size(); i++) {
+		DepthScan::Sample sample;
+		sample.fixedDepth = requests[i].fixedDepth;
+		sample.relo = relocated[i];
+		if (sample.fixedDepth)
+			sample.depth = requests[i].depth;
+		else
+			sample.depth = sample.relo ? sample.relo->dep : origin->dep;
+		scan.samples.push_back(sample);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const DepthScan::Sample *DepthScan::freeDepth() const
+{
+	for (const Sample &sample : samples) {
+		if ( ! sample.fixedDepth)
+			return &sample;
+	}
+	return NULL;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const DepthScan::Sample *DepthScan::fixedDepth(double depth) const
+{
+	for (const Sample &sample : samples) {
+		if (sample.fixedDepth && sample.depth == depth)
+			return &sample;
+	}
+	return NULL;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
 }  // namespace Autoloc
 
 }  // namespace Seiscomp
@@ -17,6 +17,9 @@
 
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
+#include <unordered_map>
 
 #include <seiscomp/seismology/locator/locsat.h>
 #include <seiscomp/autoloc/datamodel.h>
@@ -38,8 +41,81 @@ class MySensorLocationDelegate : public Seiscomp::Seismology::SensorLocationDele
 			getSensorLocation(Seiscomp::DataModel::Pick *pick) const;
 		void setStation(const Autoloc::DataModel::Station *station);
 	private:
+		// by station code, by network code, so that a lookup
+		// doesn't need to build a NET.STA string
 		typedef std::map<std::string, Seiscomp::DataModel::SensorLocationPtr> SensorLocationList;
-		SensorLocationList _sensorLocations;
+		std::map<std::string, SensorLocationList> _sensorLocations;
+};
+
+
+
+// Tolerances for skipping the second LocSAT invocation. If the result
+// of the first invocation differs from its input by less than these,
+// the first result is considered converged. Values <= 0 enforce the
+// second invocation, which is the default.
+class SecondPassTolerances {
+	public:
+		// hypocentral shift in km
+		double maxShift{0.};
+		// origin time shift in s
+		double maxTimeShift{0.};
+		// change of RMS residual in s
+		double maxRMSChange{0.};
+};
+
+
+
+// Relocation counts and latencies per call site
+class RelocationStatistics {
+	public:
+		enum CallSite {
+			Other,
+			NucleatorCandidate,
+			NucleatorFinal,
+			Associate,
+			Rework,
+			TrimResiduals,
+			EnsureAcceptableRMS,
+			EnhanceScore,
+			Depth,
+			Merge,
+			XXL,
+			ManualOrigin,
+			ImportedOrigin,
+			CallSiteCount
+		};
+
+		static const char *name(CallSite);
+
+	public:
+		RelocationStatistics();
+
+		// record a relocation and its duration in seconds
+		void add(CallSite, bool success, double duration);
+
+		// add the counts of another instance
+		void merge(const RelocationStatistics&);
+
+		void reset();
+
+		// log counts and latency percentiles of all call sites
+		void dump(const std::string &title) const;
+
+	private:
+		// The latencies are kept in a histogram with
+		// logarithmic bins, 10 us * 1.25^i for i < BinCount.
+		enum { BinCount = 64 };
+
+		// upper bound of the latency percentile p (0...1)
+		double _percentile(CallSite, double p) const;
+
+		struct Site {
+			size_t success;
+			size_t failure;
+			double duration;
+			size_t bins[BinCount];
+		};
+		Site _sites[CallSiteCount];
 };
 
 
@@ -60,26 +136,217 @@ class Locator {
 		void setFixedDepth(double depth, bool use=true);
 		void useFixedDepth(bool use=true);
 
+		// Maximum number of relocation results kept in the
+		// relocation cache. 0 disables the cache.
+		void setCacheSize(size_t);
+
+		size_t cacheHits() const { return _cacheHits; }
+		size_t cacheMisses() const { return _cacheMisses; }
+
+		void setSecondPassTolerances(const SecondPassTolerances&);
+
+		// number of skipped second LocSAT invocations
+		size_t secondPassesSkipped() const { return _secondPassesSkipped; }
+
+		// The call site the following relocations are counted for
+		void setCallSite(RelocationStatistics::CallSite site) { _callSite = site; }
+		RelocationStatistics::CallSite callSite() const { return _callSite; }
+
+		const RelocationStatistics &statistics() const { return _statistics; }
+
+		// Set the call site of a Locator for the lifetime of
+		// this object and restore the previous one afterwards.
+		class CallSiteScope {
+			public:
+				CallSiteScope(Locator &locator, RelocationStatistics::CallSite site)
+					: _locator(locator), _previous(locator.callSite()) {
+					_locator.setCallSite(site);
+				}
+				~CallSiteScope() {
+					_locator.setCallSite(_previous);
+				}
+			private:
+				Locator &_locator;
+				RelocationStatistics::CallSite _previous;
+		};
+
 	public:
 		Autoloc::DataModel::Origin *relocate(
 			const Autoloc::DataModel::Origin *origin);
 
+		// Relocate with the depth setting passed explicitly. The
+		// previous depth setting of the locator is restored
+		// afterwards.
+		Autoloc::DataModel::Origin *relocate(
+			const Autoloc::DataModel::Origin *origin,
+			bool fixedDepth, double depth);
+
 
 	private:
+		// relocate() without the statistics
+		Autoloc::DataModel::Origin *_relocate(
+			const Autoloc::DataModel::Origin *origin);
+
 		// this is the SeisComP-level relocate
 		Autoloc::DataModel::Origin *_screlocate(
 			const Autoloc::DataModel::Origin *origin);
 
+		// Decide whether the result of the first LocSAT
+		// invocation requires a second one.
+		bool _needsSecondPass(
+			const Autoloc::DataModel::Origin *input,
+			const Seiscomp::DataModel::Origin *result) const;
+
+		// Relocation cache
+		//
+		// The result of a relocation depends on the starting
+		// hypocenter, the arrivals and the depth setting of the
+		// locator. These make up the cache key. The cache is
+		// cleared when the locator profile or the second-pass
+		// tolerances change. Only successful relocations are
+		// cached. A cached result is applied to a copy of the
+		// origin to relocate, so the attributes not touched by
+		// the locator are preserved.
+		struct CacheEntry {
+			std::string key;
+			Autoloc::DataModel::OriginCPtr relo;
+			bool depthMinimum;
+		};
+		typedef std::list<CacheEntry> CacheList;
+
+		std::string _cacheKey(
+			const Autoloc::DataModel::Origin *origin) const;
+		Autoloc::DataModel::Origin *_fromCache(
+			const Autoloc::DataModel::Origin *origin,
+			const CacheEntry &entry) const;
+		void _cacheStore(
+			const std::string &key,
+			const Autoloc::DataModel::Origin *relo,
+			bool depthMinimum);
+		void _clearCache();
+
 	private:
 		Seiscomp::Seismology::LocatorInterfacePtr sclocator;
 		const Seiscomp::Config::Config *scconfig;
 
 		MySensorLocationDelegatePtr sensorLocationDelegate;
 
+		// The origin passed to LocSAT. It is reused for every
+		// relocation and updated in place to save allocations.
+		Seiscomp::DataModel::OriginPtr _scorigin;
+
 		double _minDepth;
 
 		// for debugging count locator calls
 		size_t _locatorCallCounter;
+
+		// most recently used first
+		CacheList _cache;
+		std::unordered_map<std::string, CacheList::iterator> _cacheIndex;
+		size_t _cacheSize;
+		size_t _cacheHits, _cacheMisses;
+
+		SecondPassTolerances _secondPassTolerances;
+		size_t _secondPassesSkipped;
+
+		RelocationStatistics::CallSite _callSite;
+		RelocationStatistics _statistics;
+};
+
+
+
+// A single relocation request to a LocatorPool. In contrast to the
+// Locator, the depth setting is part of the request.
+struct RelocationRequest {
+	const Autoloc::DataModel::Origin *origin;
+	bool fixedDepth;
+	double depth; // only used if fixedDepth is true
+	RelocationStatistics::CallSite callSite{RelocationStatistics::Other};
+};
+
+typedef std::vector<RelocationRequest> RelocationRequestVector;
+
+
+
+// The relocations of an origin with free depth and at a set of fixed
+// depths, i.e. the misfit as function of depth.
+class DepthScan {
+	public:
+		struct Sample {
+			// fixed depth, or the resulting depth if free
+			double depth;
+			bool fixedDepth;
+			// NULL if the relocation failed
+			Autoloc::DataModel::OriginPtr relo;
+		};
+
+		// the sample with free depth or NULL
+		const Sample *freeDepth() const;
+
+		// the sample with the given fixed depth or NULL
+		const Sample *fixedDepth(double depth) const;
+
+		// free depth first, then in order of increasing depth
+		std::vector<Sample> samples;
+};
+
+
+
+// A pool of independently configured Locator instances, each with its
+// own LocSAT instance and sensor locations. Several requests can thus
+// be processed concurrently, one thread per Locator.
+//
+// Note that the pool size is currently limited to 1. The relocation
+// creates SC objects and looks up SC picks through the PublicObject
+// registry, which must not be done by several threads at once.
+class LocatorPool {
+	public:
+		LocatorPool();
+		~LocatorPool();
+
+		void setConfig(const Seiscomp::Config::Config*);
+		void setProfile(const std::string &name);
+
+		// Create the given number of Locator instances
+		bool init(size_t size=1);
+
+		size_t size() const;
+
+		void setStation(const Autoloc::DataModel::Station *station);
+		void setMinimumDepth(double);
+		double minimumDepth() const;
+		void setCacheSize(size_t);
+		void setSecondPassTolerances(const SecondPassTolerances&);
+
+	public:
+		// Relocate all requests. The result for requests[i] is
+		// results[i], which is NULL if the relocation failed.
+		//
+		// The results do not depend on the pool size.
+		void relocate(
+			const RelocationRequestVector &requests,
+			Autoloc::DataModel::OriginVector &results);
+
+		// Relocate a single request using the first Locator
+		Autoloc::DataModel::Origin *relocate(
+			const RelocationRequest &request);
+
+		// Relocate the origin with free depth, if requested, and
+		// at each of the given fixed depths concurrently.
+		void depthScan(
+			const Autoloc::DataModel::Origin *origin,
+			const std::vector<double> &depths,
+			bool freeDepth, DepthScan &scan,
+			RelocationStatistics::CallSite site=RelocationStatistics::Depth);
+
+		// the statistics of all Locator instances
+		RelocationStatistics statistics() const;
+
+	private:
+		// the pool owns the Locator instances
+		std::vector<Locator*> _locators;
+		const Seiscomp::Config::Config *scconfig;
+		double _minDepth;
 };
 
 }  // namespace Autoloc
@@ -26,6 +26,7 @@
 #include <vector>
 #include <set>
 #include <list>
+#include <algorithm>
 #include <math.h>
 
 #include <seiscomp/autoloc/util.h>
@@ -35,26 +36,17 @@
 
 namespace Seiscomp {
 
-// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-static std::string station_key (const Autoloc::DataModel::Station *station)
-{
-	return station->net + "." + station->code;
-}
-// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
-
-
-
-
-
-typedef std::set<Autoloc::DataModel::PickCPtr> PickSet;
+typedef std::pmr::set<Autoloc::DataModel::PickCPtr> PickSet;
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void Nucleator::setStation(const Autoloc::DataModel::Station *station)
 {
-	std::string key = station->net + "." + station->code;
-	if (_stations.find(key) != _stations.end())
+	Autoloc::DataModel::Station::Handle h = station->handle;
+	if (h >= _stations.size())
+		_stations.resize(h+1);
+	if (_stations[h])
 		return; // nothing to insert
-	_stations.insert(Autoloc::DataModel::StationMap::value_type(key, station));
+	_stations[h] = station;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -66,6 +58,9 @@ GridSearchConfig::GridSearchConfig() {
 	nmin = 5;
 	dmax = 180;
 	amin = 5*nmin;
+	locatorPoolSize = 1;
+	relocationCacheSize = 1000;
+	preLocatorMaxRMS = 0;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -77,6 +72,21 @@ GridSearch::GridSearch() {
 	scconfig = NULL;
 //	_stations = 0;
 	_abort = false;
+	_cleanupIndex = 0;
+	_arena = nullptr;
+	_candidatesRelocated = _candidatesScreenedOut = 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+GridSearch::~GridSearch() {
+	if (_config.preLocatorMaxRMS > 0)
+		SEISCOMP_INFO(
+			"Pre-locator: %ld candidates relocated, %ld screened out",
+			_candidatesRelocated, _candidatesScreenedOut);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -96,7 +106,7 @@ void GridSearch::setConfig(const Seiscomp::Config::Config *conf) {
 void GridSearch::setStation(const Autoloc::DataModel::Station *station)
 {
 	Nucleator::setStation(station);
-	_relocator.setStation(station);
+	_relocators.setStation(station);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -106,10 +116,12 @@ void GridSearch::setStation(const Autoloc::DataModel::Station *station)
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool GridSearch::init()
 {
-	_relocator.setConfig(scconfig);
+	_relocators.setConfig(scconfig);
 
-	if ( ! _relocator.init())
+	if ( ! _relocators.init(_config.locatorPoolSize))
 		return false;
+	_relocators.setCacheSize(_config.relocationCacheSize);
+	_relocators.setSecondPassTolerances(_config.secondPassTolerances);
 	return true;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -142,7 +154,7 @@ const std::string& GridSearch::gridFilename() const
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void GridSearch::setLocatorProfile(const std::string &profile) {
-	_relocator.setProfile(profile);
+	_relocators.setProfile(profile);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -163,6 +175,24 @@ int GridSearch::cleanup(const Autoloc::DataModel::Time& minTime)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+int GridSearch::cleanup(const Autoloc::DataModel::Time& minTime, size_t gridPointCount)
+{
+	int count = 0;
+	size_t n = std::min(gridPointCount, _grid.size());
+	for (size_t i=0; i<n; i++) {
+		if (_cleanupIndex >= _grid.size())
+			_cleanupIndex = 0;
+		count += _grid[_cleanupIndex++]->cleanup(minTime);
+	}
+
+	return count;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 static int _projectedPickCount=0;
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
@@ -241,21 +271,20 @@ GridPoint::GridPoint(const Autoloc::DataModel::Origin &origin)
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 const Autoloc::DataModel::Origin*
-GridPoint::feed(const Autoloc::DataModel::Pick* pick)
+GridPoint::feed(
+	const Autoloc::DataModel::Pick* pick,
+	std::pmr::memory_resource *memory)
 {
 	// find the station corresponding to the pick
-	const std::string key = station_key(pick->station());
-
-	std::map<std::string, StationWrapperCPtr>::const_iterator
-		xit = _wrappers.find(key);
-	if (xit==_wrappers.end())
+	const StationWrapper *wrapper = _wrapper(pick->station()->handle);
+	if ( ! wrapper)
 		// this grid cell may be out of range for that station
 		return NULL;
-	StationWrapperCPtr wrapper = (*xit).second;
 	if ( ! wrapper->station ) {
 		// TODO test in Nucleator::feed() and use logging
 		// TODO at this point probably an exception should be thrown
-		SEISCOMP_ERROR("Nucleator: station '%s' not found", key.c_str());
+		SEISCOMP_ERROR("Nucleator: station '%s.%s' not found",
+			       pick->net().c_str(), pick->sta().c_str());
 		return NULL;
 		
 	}
@@ -283,9 +312,13 @@ GridPoint::feed(const Autoloc::DataModel::Pick* pick)
 	std::multiset<ProjectedPick>::iterator it,
 		lower  = _picks.lower_bound(pp.projectedTime() - _dt),
 		upper  = _picks.upper_bound(pp.projectedTime() + _dt);
-	std::vector<ProjectedPick> pps;
-	for (it=lower; it!=upper; ++it)
+	std::pmr::vector<ProjectedPick> pps(memory);
+	for (it=lower; it!=upper; ++it) {
+		// released SC pick, would fail in the locator
+		if ( ! it->p->scpick)
+			continue;
 		pps.push_back(*it);
+	}
 
 	int npick=pps.size();
 
@@ -295,8 +328,8 @@ GridPoint::feed(const Autoloc::DataModel::Pick* pick)
 
 	// now take a closer look at how tightly clustered the picks are
 	double dt0 = 4; // XXX
-	std::vector<int> _cnt(npick);
-	std::vector<int> _flg(npick);
+	std::pmr::vector<int> _cnt(npick, memory);
+	std::pmr::vector<int> _flg(npick, memory);
 	for (int i=0; i<npick; i++) {
 		_cnt[i] = _flg[i] = 0;
 	}
@@ -333,7 +366,7 @@ GridPoint::feed(const Autoloc::DataModel::Pick* pick)
 	if (sum < _nmin)
 		return NULL;
 
-	std::vector<ProjectedPick> group;
+	std::pmr::vector<ProjectedPick> group(memory);
 	int cntmax = 0;
 	Autoloc::DataModel::Time otime;
 	for (int i=0; i<npick; i++) {
@@ -349,26 +382,25 @@ GridPoint::feed(const Autoloc::DataModel::Pick* pick)
 
 // vvvvvvvvvvvvv Iteration
 
-	std::vector<double> ptime(npick);
+	std::pmr::vector<double> ptime(npick, memory);
 	for (int i=0; i<npick; i++) {
 		ptime[i] = pps[i].projectedTime();
 	}
 
 //	Autoloc::DataModel::Origin* origin = new Autoloc::DataModel::Origin(lat, lon, dep, otime);
 	_origin->arrivals.clear();
+	_arrivalWrappers.clear();
 	// add Picks/Arrivals to that newly created Origin
-	std::set<std::string> stations;
+	std::pmr::set<Autoloc::DataModel::Station::Handle> stations(memory);
 	for (unsigned int i=0; i<group.size(); i++) {
 		const ProjectedPick &pp = group[i];
 
 		Autoloc::DataModel::PickCPtr pick = pp.p;
-		const std::string key = station_key(pick->station());
 		// avoid duplicate stations XXX ugly without amplitudes
-		if( stations.count(key))
+		if ( ! stations.insert(pick->station()->handle).second)
 			continue;
-		stations.insert(key);
 
-		StationWrapperCPtr sw( _wrappers[key]);
+		const StationWrapper *sw = pp.wrapper.get();
 
 		Autoloc::DataModel::Arrival arr(pick.get());
 		arr.residual = pp.projectedTime() - otime;
@@ -378,6 +410,7 @@ GridPoint::feed(const Autoloc::DataModel::Pick* pick)
 		arr.phase = (pick->time - otime < 960.) ? "P" : "PKP";
 //		arr.weight   = 1;
 		_origin->arrivals.push_back(arr);
+		_arrivalWrappers.push_back(sw);
 	}
 
 	if (_origin->arrivals.size() < (size_t)_nmin)
@@ -390,6 +423,89 @@ GridPoint::feed(const Autoloc::DataModel::Pick* pick)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool GridPoint::prelocate(PreLocation &result) const
+{
+	// Unknowns are the origin time shift and the epicentral shift
+	// (east, north) in km. The residuals are linearized as
+	//
+	//   r_i = dt - p_i*(sin(az_i)*dx + cos(az_i)*dy)/111.195
+	//
+	// with p_i being the horizontal slowness in s/deg and az_i the
+	// azimuth from the grid point to the station.
+
+	double n[3][3] = { {0,0,0}, {0,0,0}, {0,0,0} };
+	double b[3] = { 0, 0, 0 };
+	int count = 0;
+
+	size_t arrivalCount = _origin->arrivals.size();
+	for (size_t i=0; i<arrivalCount; i++) {
+		const Autoloc::DataModel::Arrival &arr = _origin->arrivals[i];
+		if (arr.excluded)
+			continue;
+
+		const StationWrapper *sw = _arrivalWrappers[i];
+		double p = sw->hslow/111.195;
+		double azi = sw->azimuth*M_PI/180.;
+		double a[3] = { 1., -p*sin(azi), -p*cos(azi) };
+
+		for (int k=0; k<3; k++) {
+			for (int l=0; l<3; l++)
+				n[k][l] += a[k]*a[l];
+			b[k] += a[k]*arr.residual;
+		}
+		count++;
+	}
+
+	if (count < 4)
+		return false;
+
+	// solve the normal equations using Cramer's rule
+	double det =
+		n[0][0]*(n[1][1]*n[2][2] - n[1][2]*n[2][1]) -
+		n[0][1]*(n[1][0]*n[2][2] - n[1][2]*n[2][0]) +
+		n[0][2]*(n[1][0]*n[2][1] - n[1][1]*n[2][0]);
+	if (std::abs(det) < 1.E-12)
+		return false;
+
+	double m[3];
+	for (int k=0; k<3; k++) {
+		double c[3][3];
+		for (int i=0; i<3; i++)
+			for (int l=0; l<3; l++)
+				c[i][l] = (l==k) ? b[i] : n[i][l];
+		m[k] = (
+			c[0][0]*(c[1][1]*c[2][2] - c[1][2]*c[2][1]) -
+			c[0][1]*(c[1][0]*c[2][2] - c[1][2]*c[2][0]) +
+			c[0][2]*(c[1][0]*c[2][1] - c[1][1]*c[2][0]))/det;
+	}
+
+	double sum = 0;
+	for (size_t i=0; i<arrivalCount; i++) {
+		const Autoloc::DataModel::Arrival &arr = _origin->arrivals[i];
+		if (arr.excluded)
+			continue;
+
+		const StationWrapper *sw = _arrivalWrappers[i];
+		double p = sw->hslow/111.195;
+		double azi = sw->azimuth*M_PI/180.;
+		double r = arr.residual
+			- m[0] + p*(sin(azi)*m[1] + cos(azi)*m[2]);
+		sum += r*r;
+	}
+
+	result.dt  = m[0];
+	result.dx  = m[1];
+	result.dy  = m[2];
+	result.rms = sqrt(sum/count);
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 int GridPoint::cleanup(const Autoloc::DataModel::Time& minTime)
 {
@@ -410,6 +526,24 @@ int GridPoint::cleanup(const Autoloc::DataModel::Time& minTime)
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+const StationWrapper *
+GridPoint::_wrapper(Autoloc::DataModel::Station::Handle h) const
+{
+	WrapperList::const_iterator it = std::lower_bound(
+		_wrappers.begin(), _wrappers.end(), h,
+		[](const WrapperList::value_type &w, Autoloc::DataModel::Station::Handle x) {
+			return w.first < x;
+		});
+	if (it == _wrappers.end() || it->first != h)
+		return nullptr;
+	return it->second.get();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool GridPoint::setupStation(const Autoloc::DataModel::Station *station)
 {
@@ -427,8 +561,17 @@ bool GridPoint::setupStation(const Autoloc::DataModel::Station *station)
 		return false;
 
 	StationWrapperCPtr sw = new StationWrapper(station, tt.phase, delta, az, tt.time, tt.dtdd);
-	std::string key = station_key (sw->station);
-	_wrappers[key] = sw;
+
+	// keep _wrappers sorted by station handle
+	WrapperList::iterator it = std::lower_bound(
+		_wrappers.begin(), _wrappers.end(), station->handle,
+		[](const WrapperList::value_type &w, Autoloc::DataModel::Station::Handle x) {
+			return w.first < x;
+		});
+	if (it != _wrappers.end() && it->first == station->handle)
+		it->second = sw;
+	else
+		_wrappers.insert(it, WrapperList::value_type(station->handle, sw));
 
 	return true;
 }
@@ -438,13 +581,15 @@ bool GridPoint::setupStation(const Autoloc::DataModel::Station *station)
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-static PickSet originPickSet(const Autoloc::DataModel::Origin *origin)
+static PickSet originPickSet(
+	const Autoloc::DataModel::Origin *origin,
+	std::pmr::memory_resource *memory)
 {
-	PickSet picks;
+	PickSet picks(memory);
 
 	int arrivalCount = origin->arrivals.size();
 	for(int i=0; i<arrivalCount; i++) {
-		Autoloc::DataModel::Arrival &arr = ((Autoloc::DataModel::Origin*)origin)->arrivals[i];
+		const Autoloc::DataModel::Arrival &arr = origin->arrivals[i];
 		if (arr.excluded) continue;
 		picks.insert(arr.pick);
 	}
@@ -489,32 +634,29 @@ bool GridSearch::feed(const Autoloc::DataModel::Pick *pick)
 		exit(1);
 	}
 
-	std::string key = pick->net() + "." + pick->sta() + "." + pick->loc();
-
-	// link pick to station through pointer
-
-/*
-NOT NEEDED - a pick must have a station associated to it by now
-	if (pick->station() == 0) {
-		StationMap::const_iterator it = _stations.find(key);
-		if (it == _stations.end()) {
-			SEISCOMP_ERROR_S("\nGridSearch::feed() NO STATION " + key + "\n");
-			return false;
-		}
-		SEISCOMP_ERROR("GridSearch::feed()  THIS SHOULD NEVER HAPPEN");
-		pick->setStation((*it).second.get());
-	}
-*/
+	// a pick must have a station associated to it by now
+	Station::Handle h = pick->station()->handle;
 
 	// If not done already, set up the grid for this station now.
 	bool stationSetupNeeded = false;
-	if (_configuredStations.find(key) == _configuredStations.end()) {
-		_configuredStations.insert(key);
+	if (h >= _configuredStations.size())
+		_configuredStations.resize(h+1, false);
+	if ( ! _configuredStations[h]) {
+		_configuredStations[h] = true;
 		stationSetupNeeded = true;
-		SEISCOMP_DEBUG_S("GridSearch: setting up station " + key);
+		SEISCOMP_DEBUG("GridSearch: setting up station %s.%s",
+			       pick->net().c_str(), pick->sta().c_str());
 	}
 
-	std::map<PickSet, OriginPtr> pickSetOriginMap;
+	// The candidate bookkeeping is only needed during this call
+	std::pmr::memory_resource *memory = _arena
+		? static_cast<std::pmr::memory_resource*>(_arena)
+		: std::pmr::get_default_resource();
+
+	std::pmr::map<PickSet, OriginPtr> pickSetOriginMap(memory);
+
+	// candidates rejected by the pre-locator
+	std::pmr::set<PickSet> screenedOut(memory);
 
 	// Main loop
 	//
@@ -526,7 +668,7 @@ NOT NEEDED - a pick must have a station associated to it by now
 		if (stationSetupNeeded)
 			gp->setupStation(pick->station());
 
-		const Origin *result = gp->feed(pick);
+		const Origin *result = gp->feed(pick, memory);
 		if ( ! result)
 			continue;
 
@@ -543,7 +685,7 @@ NOT NEEDED - a pick must have a station associated to it by now
 			// this is actually an unexpected condition!
 			continue;
 
-		const PickSet pickSet = originPickSet(result);
+		const PickSet pickSet = originPickSet(result, memory);
 		// test if we already have an origin with this particular pick set
 		if (pickSetOriginMap.find(pickSet) != pickSetOriginMap.end()) {
 			double score1 = Autoloc::originScore(pickSetOriginMap[pickSet].get());
@@ -574,10 +716,28 @@ NOT NEEDED - a pick must have a station associated to it by now
 		OriginPtr newOrigin = new Origin(*result);
 
 		pickSetOriginMap[pickSet] = newOrigin;
+
+		// Screen the candidate by a cheap linearized pre-location.
+		// It is rejected if the fit is poor or if the epicenter
+		// moves out of the grid cell, in which case a neighbouring
+		// grid point yields a better candidate.
+		screenedOut.erase(pickSet);
+		if (_config.preLocatorMaxRMS > 0) {
+			PreLocation preloc;
+			if (gp->prelocate(preloc)) {
+				double shift = sqrt(preloc.dx*preloc.dx + preloc.dy*preloc.dy)/111.195;
+				if (preloc.rms > _config.preLocatorMaxRMS || shift > gp->_radius)
+					screenedOut.insert(pickSet);
+			}
+		}
 	}
 
-	OriginVector tempOrigins;
-	for (std::map<PickSet, OriginPtr>::iterator
+	// Relocate all candidates with fixed depth. The candidates are
+	// independent of each other and are relocated in one go by
+	// the locator pool. As before, the depth is fixed at the
+	// minimum depth.
+	Autoloc::RelocationRequestVector requests;
+	for (std::pmr::map<PickSet, OriginPtr>::iterator
 	     it = pickSetOriginMap.begin(); it != pickSetOriginMap.end(); ++it) {
 
 		Origin *origin = (*it).second.get();
@@ -588,8 +748,25 @@ NOT NEEDED - a pick must have a station associated to it by now
 // Hier nur jene Origins aus Gridsearch zulassen, die nicht mehrheitlich aus assoziierten Picks bestehen.
 // XXX XXX XXX XXX XXX
 
-		_relocator.useFixedDepth(true); // XXX vorher true
-		OriginPtr relo = _relocator.relocate(origin);
+		if (screenedOut.count((*it).first)) {
+			_candidatesScreenedOut++;
+			continue;
+		}
+		_candidatesRelocated++;
+
+		Autoloc::RelocationRequest request;
+		request.origin = origin;
+		request.fixedDepth = true;
+		request.depth = _relocators.minimumDepth();
+		request.callSite = Autoloc::RelocationStatistics::NucleatorCandidate;
+		requests.push_back(request);
+	}
+
+	OriginVector relocated;
+	_relocators.relocate(requests, relocated);
+
+	OriginVector tempOrigins;
+	for (OriginPtr relo : relocated) {
 		if ( ! relo)
 			continue;
 
@@ -613,8 +790,12 @@ NOT NEEDED - a pick must have a station associated to it by now
 
 	OriginPtr best = bestOrigin(tempOrigins);
 	if (best) {
-		_relocator.useFixedDepth(false);
-		OriginPtr relo = _relocator.relocate(best.get());
+		Autoloc::RelocationRequest request;
+		request.origin = best.get();
+		request.fixedDepth = false;
+		request.depth = 0;
+		request.callSite = Autoloc::RelocationStatistics::NucleatorFinal;
+		OriginPtr relo = _relocators.relocate(request);
 		if (relo)
 			_newOrigins.push_back(relo);
 	}
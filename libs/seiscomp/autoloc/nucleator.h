@@ -26,6 +26,7 @@
 #include <seiscomp/config/config.h>
 #include <seiscomp/autoloc/datamodel.h>
 #include <seiscomp/autoloc/locator.h>
+#include <seiscomp/autoloc/arena.h>
 
 
 namespace Seiscomp {
@@ -53,10 +54,13 @@ class Nucleator
 		virtual void setup() = 0;
 
 	protected:
-		Autoloc::DataModel::StationMap _stations;
+		// indexed by station handle
+		std::vector<Autoloc::DataModel::StationCPtr> _stations;
 //		double _config_maxDistanceXXL;
 
-		std::set<std::string> _configuredStations;
+		// stations for which the grid has been set up,
+		// indexed by station handle
+		std::vector<bool> _configuredStations;
 
 	public:
 		Autoloc::DataModel::OriginVector _newOrigins;
@@ -84,6 +88,21 @@ class GridSearchConfig {
 	
 		// minimum cumulative amplitude of all picks
 		double amin;
+
+		// number of locator instances used to relocate
+		// candidate origins concurrently
+		int locatorPoolSize;
+
+		// size of the relocation cache per locator instance
+		int relocationCacheSize;
+
+		Autoloc::SecondPassTolerances secondPassTolerances;
+
+		// Maximum RMS of the linearized pre-location of a
+		// candidate origin. Candidates exceeding it, or moving
+		// out of their grid cell, are not relocated.
+		// 0 disables the pre-locator.
+		double preLocatorMaxRMS;
 };
 
 
@@ -91,6 +110,7 @@ class GridSearch : public Nucleator
 {
 	public:
 		GridSearch();
+		~GridSearch();
 		virtual bool init();
 
 	public:
@@ -106,12 +126,25 @@ class GridSearch : public Nucleator
 
 		void setLocatorProfile(const std::string&);
 
+		// Memory for the transient candidate bookkeeping in
+		// feed(). The owner resets it after each pick.
+		void setArena(Autoloc::Arena *arena) { _arena = arena; }
+
+		Autoloc::RelocationStatistics relocationStatistics() const {
+			return _relocators.statistics();
+		}
+
 	public:
 		// Feed a pick to the nucleator.
 		// The pick *must* already have a station associated.
 		bool feed(const Autoloc::DataModel::Pick *pick);
 	
 		int cleanup(const Autoloc::DataModel::Time& minTime);
+
+		// Like cleanup() but only for the next gridPointCount grid
+		// points, continuing where the previous call stopped. Allows
+		// to spread the cleanup over many calls.
+		int cleanup(const Autoloc::DataModel::Time& minTime, size_t gridPointCount);
 	
 		void reset()
 		{
@@ -135,10 +168,19 @@ class GridSearch : public Nucleator
 	private:
 		std::string _gridFilename;
 		Grid    _grid;
-		Autoloc::Locator _relocator;
+		Autoloc::LocatorPool _relocators;
 
 		bool _abort;
 
+		// next grid point for an incremental cleanup
+		size_t _cleanupIndex;
+
+		Autoloc::Arena *_arena;
+
+		// pre-locator statistics
+		size_t _candidatesRelocated;
+		size_t _candidatesScreenedOut;
+
 	public: // FIXME: make private
 		GridSearchConfig  _config;
 	private:
@@ -211,6 +253,18 @@ class ProjectedPick {
 };
 
 
+// Result of the linearized pre-location of a candidate origin
+class PreLocation {
+	public:
+		// epicentral shift relative to the grid point in km
+		double dx{0}, dy{0};
+		// origin time shift in s
+		double dt{0};
+		// RMS of the adjusted residuals in s
+		double rms{0};
+};
+
+
 class GridPoint : public Autoloc::DataModel::Hypocenter
 {
 	public:
@@ -226,11 +280,23 @@ class GridPoint : public Autoloc::DataModel::Hypocenter
 
 	public:
 		// feed a new pick and perhaps get a new origin
-		const Autoloc::DataModel::Origin* feed(const Autoloc::DataModel::Pick*);
+		//
+		// Temporary containers are allocated from the given
+		// memory, e.g. an Arena.
+		const Autoloc::DataModel::Origin* feed(
+			const Autoloc::DataModel::Pick*,
+			std::pmr::memory_resource *memory=std::pmr::get_default_resource());
 
 		// remove all picks older than tmin
 		int cleanup(const Autoloc::DataModel::Time& minTime);
 
+		// Linearized least-squares adjustment of epicenter and
+		// origin time of the origin returned by the last feed(),
+		// using the horizontal slowness stored for the grid
+		// point. The depth is kept fixed. This is much cheaper
+		// than a relocation and does not allocate memory.
+		bool prelocate(PreLocation &result) const;
+
 	public:
 //		void setStations(const StationMap *stations);
 
@@ -247,9 +313,19 @@ class GridPoint : public Autoloc::DataModel::Hypocenter
 		int _nminPrelim;
 
 	private:
-		std::map<std::string, StationWrapperCPtr> _wrappers;
+		const StationWrapper *_wrapper(Autoloc::DataModel::Station::Handle) const;
+
+	private:
+		// Sorted by station handle. Only stations within range
+		// of the grid point are set up, so a dense vector would
+		// mostly hold null pointers.
+		typedef std::vector< std::pair<Autoloc::DataModel::Station::Handle, StationWrapperCPtr> > WrapperList;
+		WrapperList _wrappers;
 		std::multiset<ProjectedPick> _picks;
 		Autoloc::DataModel::OriginPtr _origin;
+
+		// the station wrappers of the arrivals of _origin
+		std::vector<const StationWrapper*> _arrivalWrappers;
 };
 
 //double originScore(const Autoloc::DataModel::Origin *origin, double maxRMS=3.5, double radius=0.);
@@ -0,0 +1,176 @@
+/***************************************************************************
+ * Copyright (C) GFZ Potsdam                                               *
+ * All rights reserved.                                                    *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ ***************************************************************************/
+
+
+#ifndef SEISCOMP_LIBAUTOLOC_PARALLEL_H_INCLUDED
+#define SEISCOMP_LIBAUTOLOC_PARALLEL_H_INCLUDED
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Seiscomp {
+
+namespace Autoloc {
+
+
+// Call f(worker, i) for all i in [0, n). The index range is split into
+// contiguous shards, one per worker, and each shard is processed in its
+// own thread. Worker 0 is the calling thread. With a worker count <= 1
+// this is a plain serial loop.
+//
+// f may only read shared state and write results per index (or per
+// worker). Merging the results is left to the caller, who can thus do
+// it in index order, independent of the number of workers.
+template <typename F>
+void parallelFor(size_t n, size_t workers, F f)
+{
+	if (workers > n)
+		workers = n;
+
+	if (workers <= 1) {
+		for (size_t i=0; i<n; i++)
+			f(0, i);
+		return;
+	}
+
+	size_t shard = (n + workers - 1) / workers;
+
+	std::vector<std::thread> threads;
+	for (size_t w=1; w<workers; w++) {
+		size_t begin = w*shard;
+		size_t end = std::min(n, begin+shard);
+		if (begin >= end)
+			break;
+		threads.push_back(std::thread([&f, w, begin, end]() {
+			for (size_t i=begin; i<end; i++)
+				f(w, i);
+		}));
+	}
+
+	for (size_t i=0; i<shard; i++)
+		f(0, i);
+
+	for (std::thread &t: threads)
+		t.join();
+}
+
+
+
+// Like parallelFor(), but with threads that are started once and then
+// wait for work. Use this where a parallel loop is short and run often,
+// so that starting threads would cost more than the loop itself.
+//
+// Only one thread may call run() at a time.
+class WorkerPool {
+	public:
+		// The worker count includes the calling thread
+		explicit WorkerPool(size_t workers) {
+			for (size_t w=1; w<workers; w++)
+				_threads.push_back(std::thread([this, w]() { _loop(w); }));
+		}
+
+		~WorkerPool() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_start.notify_all();
+			for (std::thread &t: _threads)
+				t.join();
+		}
+
+		size_t size() const { return _threads.size()+1; }
+
+		// Call f(worker, i) for all i in [0, n), see parallelFor()
+		template <typename F>
+		void run(size_t n, F f) {
+			size_t workers = std::min(n, size());
+			if (workers <= 1) {
+				for (size_t i=0; i<n; i++)
+					f(0, i);
+				return;
+			}
+
+			size_t shard = (n + workers - 1) / workers;
+			auto task = [&f, n, shard](size_t w) {
+				size_t end = std::min(n, (w+1)*shard);
+				for (size_t i=w*shard; i<end; i++)
+					f(w, i);
+			};
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_call = &_invoke<decltype(task)>;
+				_task = &task;
+				_active = _pending = workers-1;
+				_round++;
+			}
+			_start.notify_all();
+
+			task(0);
+
+			std::unique_lock<std::mutex> lock(_mutex);
+			_done.wait(lock, [this]() { return _pending == 0; });
+		}
+
+	private:
+		template <typename T>
+		static void _invoke(void *task, size_t w) {
+			(*static_cast<T*>(task))(w);
+		}
+
+		void _loop(size_t w) {
+			size_t round = 0;
+			while (true) {
+				std::unique_lock<std::mutex> lock(_mutex);
+				_start.wait(lock, [&]() { return _stop || _round != round; });
+				if (_stop)
+					return;
+				round = _round;
+				// not needed for this round
+				if (w > _active)
+					continue;
+
+				void (*call)(void*, size_t) = _call;
+				void *task = _task;
+				lock.unlock();
+
+				call(task, w);
+
+				lock.lock();
+				if (--_pending == 0)
+					_done.notify_one();
+			}
+		}
+
+	private:
+		std::vector<std::thread> _threads;
+		std::mutex _mutex;
+		std::condition_variable _start, _done;
+
+		// the current round of work
+		void (*_call)(void*, size_t){nullptr};
+		void *_task{nullptr};
+		size_t _active{0}, _pending{0}, _round{0};
+		bool _stop{false};
+};
+
+
+}  // namespace Autoloc
+
+}  // namespace Seiscomp
+
+#endif
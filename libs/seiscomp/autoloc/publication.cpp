@@ -19,6 +19,7 @@
 #include <seiscomp/autoloc/sc3adapters.h>
 #include <seiscomp/logging/log.h>
 #include <sstream>
+#include <algorithm>
 
 
 namespace Seiscomp {
@@ -77,16 +78,13 @@ void Autoloc3::report()
 {
 	using namespace Autoloc::DataModel;
 
+	// For a first origin the record is new and the origin therefore
+	// due immediately.
 	for (OriginVector::iterator
 	     it = _newOrigins.begin(); it != _newOrigins.end(); ) {
 
 		Origin *origin = it->get();
-
-		if (_nextDue.find(origin->id) == _nextDue.end())
-			// first origin -> report immediately
-			_nextDue[origin->id] = 0;
-
-		_outgoing[origin->id] = origin;
+		_origins.touch(origin->id).outgoing = origin;
 		it = _newOrigins.erase(it);
 	}
 
@@ -96,21 +94,20 @@ void Autoloc3::report()
 
 	int dnmax = _config.publicationIntervalPickCount;
 
-//	for (std::map<int, OriginPtr>::iterator
-//	     it = _outgoing.begin(); it != _outgoing.end(); ++it) {
-//
-//		const Origin *origin = it->second.get();
+	for (const auto &item: _origins.records()) {
+		const OriginRegistry::Record &rec = item.second;
+		if ( ! rec.outgoing)
+			continue;
 
-	for (auto &item: _outgoing) {
-		const Origin *origin = item.second.get();
-		double dt = t - _nextDue[origin->id];
+		const Origin *origin = rec.outgoing.get();
+		double dt = t - rec.nextDue;
 		int dn = dnmax;
 
-		if (_lastSent.find(origin->id) != _lastSent.end()) {
+		if (rec.lastSent) {
 			size_t phaseCount =  origin->phaseCount();
-			size_t lastPhaseCount = _lastSent[origin->id]->phaseCount();
+			size_t lastPhaseCount = rec.lastSent->phaseCount();
 			// size_t phaseCount =  origin->definingPhaseCount();
-			// size_t lastPhaseCount = _lastSent[origin->id]->definingPhaseCount();
+			// size_t lastPhaseCount = rec.lastSent->definingPhaseCount();
 			dn = phaseCount - lastPhaseCount;
 		}
 
@@ -118,11 +115,15 @@ void Autoloc3::report()
 			ids.push_back(origin->id);
 	}
 
+	// The records are not ordered. Report in order of origin ID.
+	std::sort(ids.begin(), ids.end());
+
 	for (const OriginID &id: ids) {
-		const Origin *origin = _outgoing[id].get();
+		OriginRegistry::Record *rec = _origins.record(id);
+		OriginPtr origin = rec->outgoing;
 
-		if ( ! _publishable(origin) ) {
-			_outgoing.erase(id);
+		if ( ! _publishable(origin.get()) ) {
+			rec->outgoing = nullptr;
 			continue;
 		}
 
@@ -130,8 +131,8 @@ void Autoloc3::report()
 		// of this origin. If so, test if the current version
 		// has improved.
 		// TODO: perhaps move this test to _publishable()
-		if (_lastSent.find(id) != _lastSent.end()) {
-			const Origin *previous = _lastSent[id].get();
+		if (rec->lastSent) {
+			const Origin *previous = rec->lastSent.get();
 
 			// The main criterion is definingPhaseCount.
 			// However, there may be origins with additional
@@ -150,14 +151,14 @@ void Autoloc3::report()
 						"Origin %ld not sent "
 						"(no improvement)",
 						origin->id);
-					_outgoing.erase(id);
+					rec->outgoing = nullptr;
 					continue;
 				}
 			}
 		}
 
-		if (_report(origin)) {
-			SEISCOMP_INFO_S(" OUT " + printOneliner(origin));
+		if (_report(origin.get())) {
+			SEISCOMP_INFO_S(" OUT " + printOneliner(origin.get()));
 
 			// Compute the time at which the next origin in this
 			// series would be due to be reported, if any.
@@ -174,23 +175,23 @@ void Autoloc3::report()
 				dt = A*N + B;
 
 			if (dt < 0) {
-				_nextDue[id] = 0;
+				rec->nextDue = 0;
 				SEISCOMP_INFO(
 					"Autoloc3::_flush() origin=%ld  "
 					"next due IMMEDIATELY", id);
 			}
 			else {
-				_nextDue[id] = t + dt;
+				rec->nextDue = t + dt;
 				SEISCOMP_INFO(
 					"Autoloc3::_flush() origin=%ld  "
 					"next due: %s", id,
-					time2str(_nextDue[id]).c_str());
+					time2str(rec->nextDue).c_str());
 			}
 
 			// save a copy of the origin
-			_lastSent[id] = new Origin(*origin);
-			_lastSent[id]->timestamp = t;
-			_outgoing.erase(id);
+			rec->lastSent = new Origin(*origin);
+			rec->lastSent->timestamp = t;
+			rec->outgoing = nullptr;
 		}
 	}
 }
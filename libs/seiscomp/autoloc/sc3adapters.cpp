@@ -167,6 +167,92 @@ Seiscomp::DataModel::Origin *exportToSC(
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
 
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool updateSC(
+	const Autoloc::DataModel::Origin* origin,
+	Seiscomp::DataModel::Origin *scorigin)
+{
+	scorigin->setTime(
+		Seiscomp::DataModel::TimeQuantity(
+			Autoloc::sctime(origin->time), origin->timeerr,
+			Seiscomp::Core::None, Seiscomp::Core::None, Seiscomp::Core::None));
+	scorigin->setLatitude(
+		Seiscomp::DataModel::RealQuantity(
+			origin->lat, origin->laterr,
+			Seiscomp::Core::None, Seiscomp::Core::None, Seiscomp::Core::None));
+	scorigin->setLongitude(
+		Seiscomp::DataModel::RealQuantity(
+			origin->lon, origin->lonerr,
+			Seiscomp::Core::None, Seiscomp::Core::None, Seiscomp::Core::None));
+	scorigin->setDepth(
+		Seiscomp::DataModel::RealQuantity(
+			origin->dep, origin->deperr,
+			Seiscomp::Core::None, Seiscomp::Core::None, Seiscomp::Core::None));
+
+	scorigin->setMethodID(origin->methodID);
+	scorigin->setEarthModelID(origin->earthModelID);
+
+	switch ( origin->depthType ) {
+	case Autoloc::DataModel::Origin::DepthFree:
+		scorigin->setDepthType(
+			Seiscomp::DataModel::OriginDepthType(
+				Seiscomp::DataModel::FROM_LOCATION));
+		break;
+
+	case Autoloc::DataModel::Origin::DepthManuallyFixed:
+		scorigin->setDepthType(
+			Seiscomp::DataModel::OriginDepthType(
+				Seiscomp::DataModel::OPERATOR_ASSIGNED));
+		break;
+	default:
+		scorigin->setDepthType(Seiscomp::Core::None);
+		break;
+	}
+
+	size_t arrivalCount = origin->arrivals.size();
+
+	// remove surplus arrivals from the previous use
+	while (scorigin->arrivalCount() > arrivalCount)
+		scorigin->removeArrival(scorigin->arrivalCount()-1);
+
+	for (size_t i=0; i<arrivalCount; i++) {
+		const Autoloc::DataModel::Arrival &arr = origin->arrivals[i];
+
+		// This is practically impossible
+		if ( arr.pick->scpick == NULL ) {
+			SEISCOMP_ERROR_S(
+				"CRITICAL: pick not found: "+arr.pick->id());
+			return false;
+		}
+
+		// Arrivals are added after their pick ID is set, which
+		// is the index of the arrival within the origin.
+		bool reused = i < scorigin->arrivalCount();
+		Seiscomp::DataModel::ArrivalPtr scarr = reused
+			? scorigin->arrival(i)
+			: new Seiscomp::DataModel::Arrival();
+
+		scarr->setPickID(   arr.pick->id());
+		scarr->setDistance( arr.distance);
+		scarr->setAzimuth(  arr.azimuth);
+		scarr->setTimeResidual(arr.residual);
+		scarr->setTimeUsed(
+			arr.excluded == Autoloc::DataModel::Arrival::NotExcluded);
+		scarr->setWeight(
+			arr.excluded == Autoloc::DataModel::Arrival::NotExcluded ? 1. : 0.);
+		scarr->setPhase(Seiscomp::DataModel::Phase(arr.phase));
+
+		if ( ! reused)
+			scorigin->add(scarr.get());
+	}
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
 } // namespace Autoloc
 
 } // namespace Seiscomp
@@ -30,6 +30,13 @@ namespace Autoloc {
 // export an Autoloc::DataModel::Origin to a Seiscomp::DataModel::Origin
 Seiscomp::DataModel::Origin *exportToSC(const Autoloc::DataModel::Origin*, bool allPhases=true);
 
+// Update a previously exported Seiscomp::DataModel::Origin in place
+// so that it can be passed to a locator. The existing arrivals are
+// reused and only the attributes read by the locator are set, i.e.
+// unlike exportToSC() no OriginQuality is computed. All phases are
+// included.
+bool updateSC(const Autoloc::DataModel::Origin*, Seiscomp::DataModel::Origin *scorigin);
+
 } // namespace Autoloc
 
 } // namespace Seiscomp
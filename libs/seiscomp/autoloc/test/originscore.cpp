@@ -0,0 +1,367 @@
+/***************************************************************************
+ * Copyright (C) GFZ Potsdam                                               *
+ * All rights reserved.                                                    *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ ***************************************************************************/
+
+
+#define SEISCOMP_TEST_MODULE test_autoloc_originscore
+#include <seiscomp/unittest/unittests.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <math.h>
+
+#include <seiscomp/datamodel/network.h>
+#include <seiscomp/datamodel/station.h>
+#include <seiscomp/datamodel/pick.h>
+#include <seiscomp/autoloc/datamodel.h>
+#include <seiscomp/autoloc/util.h>
+
+
+using namespace Seiscomp::Autoloc;
+using DataModel::Arrival;
+
+
+namespace {
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// The helpers of the original score, as in util.cpp
+double depthFactor(double depth)
+{
+	return 1+0.0005*(200-depth);
+}
+
+double avgfn2(double x, double plateauWidth=0.2)
+{
+	if (x < -1 || x > 1)
+		return 0;
+	if (x > -plateauWidth && x < plateauWidth)
+		return 1;
+
+	x = (x + (x>0 ? -plateauWidth : plateauWidth))/(1-plateauWidth);
+	x = 0.5*(cos(x*M_PI)+1);
+	return x*x;
+}
+
+bool arrivalLess(const Arrival &a, const Arrival &b)
+{
+	if (a.distance < b.distance)
+		return true;
+	if (a.distance > b.distance)
+		return false;
+
+	return a.pick->time < b.pick->time;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// The origin score as computed before originScore() stopped modifying
+// the origin. It sorted the arrivals of the origin and stored the
+// arrival scores with them, which is done here with a copy of the
+// arrivals instead. Apart from left out comments and log output, the
+// code is otherwise unchanged.
+double referenceScore(
+	const DataModel::Origin *origin,
+	double maxRMS,
+	double networkSizeKm,
+	std::vector<Arrival> &arrivals)
+{
+	arrivals.assign(origin->arrivals.begin(), origin->arrivals.end());
+	std::sort(arrivals.begin(), arrivals.end(), arrivalLess);
+
+	double score = 0, amplScoreMax=0;
+	int arrivalCount = arrivals.size();
+	for(int i=0; i<arrivalCount; i++) {
+		double phaseScore = 1; // 1 for P / 0.3 for PKP
+		Arrival &arr = arrivals[i];
+		const DataModel::Pick *pick = arr.pick.get();
+		if ( ! pick->station())
+			continue;
+
+		arr.score = 0;
+		arr.ascore = arr.dscore = arr.tscore = 0;
+		double snr = pick->snr > 3 ? pick->snr : 3;
+		if ( snr > 1.E07 )
+			continue;
+		if ( snr > 100 )
+			snr = 100;
+
+		if (manual(pick) && ! pick->hasAmplitudeSNR)
+			snr = 10;
+
+		double normamp = pick->normamp;
+		if (manual(pick) && normamp <= 0)
+			normamp = 1;
+
+		double snrScore = log10(snr);
+
+		double d = arr.distance;
+		double r = networkSizeKm <= 0
+			? pick->station()->maxNucDist
+			: (0.5*networkSizeKm/111.195);
+		double distScore = 1.5*exp(-d*d/(r*r));
+
+		double q = 0.8;
+		if (normamp <= 0)
+			continue;
+
+		double amplScore = 1+q*(1+0.5*log10(normamp));
+		if (amplScore < 1) amplScore = 1;
+
+		if(amplScoreMax==0)
+			amplScoreMax = amplScore;
+		else {
+			if (i>2 && amplScore > amplScoreMax+0.4)
+				amplScore = amplScoreMax+0.4;
+			if (amplScore > amplScoreMax)
+				amplScoreMax = amplScore;
+		}
+
+		amplScore *= snrScore;
+
+		double timeScore = avgfn2(arr.residual/(2*maxRMS));
+
+		arr.dscore = distScore;
+		arr.ascore = amplScore;
+		arr.tscore = timeScore;
+
+		if (arr.excluded) {
+			if (arr.excluded != Arrival::UnusedPhase)
+				continue;
+			if (arr.phase.substr(0,3) != "PKP")
+				continue;
+			phaseScore = 0.3;
+		}
+
+		arr.score = phaseScore*timeScore*distScore*amplScore;
+		score += arr.score;
+	}
+
+	score *= depthFactor(origin->dep);
+
+	return score;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Picks and stations with random attributes covering all branches of
+// the score: clipped and huge SNR, missing amplitudes, manual picks,
+// excluded arrivals and PKP.
+class RandomOrigins {
+	public:
+		RandomOrigins(unsigned seed) : _random(seed) {
+			_network = Seiscomp::DataModel::Network::Create();
+			_network->setCode("XX");
+		}
+
+		DataModel::OriginPtr create(size_t arrivalCount) {
+			DataModel::OriginPtr origin =
+				new DataModel::Origin(
+					0., 0., uniform(0., 600.), 1.6E9);
+
+			for (size_t i=0; i<arrivalCount; i++) {
+				const DataModel::Pick *pick = createPick();
+
+				Arrival arr(pick, "P", uniform(-10., 10.));
+				arr.distance = uniform(0., 150.);
+				arr.azimuth = uniform(0., 360.);
+				if (arr.distance > 110)
+					arr.phase = "PKP";
+
+				switch (std::uniform_int_distribution<int>(0, 5)(_random)) {
+					case 0:
+						arr.excluded = Arrival::UnusedPhase;
+						break;
+					case 1:
+						arr.excluded = Arrival::LargeResidual;
+						break;
+					default:
+						arr.excluded = Arrival::NotExcluded;
+				}
+
+				origin->add(arr);
+			}
+
+			return origin;
+		}
+
+	private:
+		double uniform(double min, double max) {
+			return std::uniform_real_distribution<double>(min, max)(_random);
+		}
+
+		const DataModel::Pick *createPick() {
+			std::string code = "S" + std::to_string(_picks.size());
+
+			Seiscomp::DataModel::StationPtr scstation =
+				Seiscomp::DataModel::Station::Create();
+			scstation->setCode(code);
+			scstation->setLatitude(0.);
+			scstation->setLongitude(0.);
+			_network->add(scstation.get());
+
+			DataModel::StationPtr station =
+				new DataModel::Station(scstation.get());
+			station->maxNucDist = uniform(5., 180.);
+			_stations.push_back(station);
+
+			Seiscomp::DataModel::PickPtr scpick =
+				Seiscomp::DataModel::Pick::Create();
+			Seiscomp::Core::Time time(1.6E9 + uniform(0., 1200.));
+			scpick->setTime(Seiscomp::DataModel::TimeQuantity(time));
+			scpick->setWaveformID(
+				Seiscomp::DataModel::WaveformStreamID(
+					"XX", code, "", "BHZ", ""));
+			Seiscomp::DataModel::CreationInfo ci;
+			ci.setCreationTime(time);
+			scpick->setCreationInfo(ci);
+
+			DataModel::PickPtr pick = new DataModel::Pick(scpick.get());
+			pick->setStation(station.get());
+			pick->snr = pow(10., uniform(-0.5, 2.5));
+			pick->normamp = pow(10., uniform(-3., 3.));
+			pick->hasAmplitudeSNR = true;
+
+			switch (std::uniform_int_distribution<int>(0, 9)(_random)) {
+				case 0:
+					pick->snr = 2.E07;
+					break;
+				case 1:
+					pick->normamp = 0;
+					break;
+				case 2:
+					pick->status = DataModel::Pick::Manual;
+					pick->hasAmplitudeSNR = false;
+					pick->normamp = 0;
+					break;
+				case 3:
+					pick->status = DataModel::Pick::Manual;
+					break;
+				default:
+					break;
+			}
+
+			_picks.push_back(pick);
+			return pick.get();
+		}
+
+	private:
+		std::mt19937 _random;
+		Seiscomp::DataModel::NetworkPtr _network;
+		std::vector<DataModel::StationPtr> _stations;
+		std::vector<DataModel::PickPtr> _picks;
+};
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void checkScores(const DataModel::Origin *origin, double maxRMS, double radius)
+{
+	std::vector<Arrival> reference;
+	double expected = referenceScore(origin, maxRMS, radius, reference);
+
+	// The scores must be identical, not just close
+	std::vector<ArrivalScore> arrivalScores;
+	BOOST_CHECK_EQUAL(originScore(origin, maxRMS, radius), expected);
+	BOOST_CHECK_EQUAL(
+		originScore(origin, maxRMS, radius, &arrivalScores), expected);
+
+	DataModel::OriginPtr copy = new DataModel::Origin(*origin);
+	BOOST_CHECK_EQUAL(updateArrivalScores(copy.get(), maxRMS, radius), expected);
+
+	BOOST_REQUIRE_EQUAL(arrivalScores.size(), origin->arrivals.size());
+	for (const Arrival &ref : reference) {
+		int i = origin->findArrival(ref.pick.get());
+		BOOST_REQUIRE(i >= 0);
+		BOOST_CHECK_EQUAL(arrivalScores[i].score,  ref.score);
+		BOOST_CHECK_EQUAL(arrivalScores[i].dscore, ref.dscore);
+		BOOST_CHECK_EQUAL(arrivalScores[i].ascore, ref.ascore);
+		BOOST_CHECK_EQUAL(arrivalScores[i].tscore, ref.tscore);
+
+		const Arrival &stored = copy->arrivals[copy->findArrival(ref.pick.get())];
+		BOOST_CHECK_EQUAL(stored.score,  ref.score);
+		BOOST_CHECK_EQUAL(stored.dscore, ref.dscore);
+		BOOST_CHECK_EQUAL(stored.ascore, ref.ascore);
+		BOOST_CHECK_EQUAL(stored.tscore, ref.tscore);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+}
+
+
+BOOST_AUTO_TEST_SUITE(seiscomp_autoloc_originscore)
+
+
+BOOST_AUTO_TEST_CASE(sameAsOriginal) {
+	RandomOrigins origins(12345);
+
+	for (size_t arrivalCount : {0, 1, 3, 6, 20, 100}) {
+		for (int k=0; k<20; k++) {
+			DataModel::OriginPtr origin = origins.create(arrivalCount);
+			checkScores(origin.get(), 3.5, 0.);
+			checkScores(origin.get(), 1.5, 0.);
+			checkScores(origin.get(), 3.5, 500.);
+		}
+	}
+}
+
+
+BOOST_AUTO_TEST_CASE(originNotModified) {
+	RandomOrigins origins(54321);
+	DataModel::OriginPtr origin = origins.create(30);
+
+	uint64_t revision = origin->arrivals.revision();
+	std::vector<DataModel::PickCPtr> picks;
+	for (const Arrival &arr : origin->arrivals)
+		picks.push_back(arr.pick);
+
+	originScore(origin.get());
+
+	BOOST_CHECK_EQUAL(origin->arrivals.revision(), revision);
+	BOOST_REQUIRE_EQUAL(origin->arrivals.size(), picks.size());
+	for (size_t i=0; i<picks.size(); i++)
+		BOOST_CHECK(origin->arrivals[i].pick == picks[i]);
+}
+
+
+BOOST_AUTO_TEST_CASE(scoreFollowsModification) {
+	// The cached arrival order must not outlive a modification
+	RandomOrigins origins(4711);
+	DataModel::OriginPtr origin = origins.create(30);
+	checkScores(origin.get(), 3.5, 0.);
+
+	for (size_t i=0; i<origin->arrivals.size(); i+=3) {
+		Arrival arr = origin->arrivals[i];
+		arr.distance = 150 - arr.distance;
+		arr.residual = -arr.residual;
+		origin->arrivals.set(i, arr);
+	}
+	checkScores(origin.get(), 3.5, 0.);
+
+	origin->arrivals.setExcluded(0, Arrival::LargeResidual);
+	checkScores(origin.get(), 3.5, 0.);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,226 @@
+/***************************************************************************
+ * Copyright (C) GFZ Potsdam                                               *
+ * All rights reserved.                                                    *
+ *                                                                         *
+ * GNU Affero General Public License Usage                                 *
+ * This file may be used under the terms of the GNU Affero                 *
+ * Public License version 3.0 as published by the Free Software Foundation *
+ * and appearing in the file LICENSE included in the packaging of this     *
+ * file. Please review the following information to ensure the GNU Affero  *
+ * Public License version 3.0 requirements will be met:                    *
+ * https://www.gnu.org/licenses/agpl-3.0.html.                             *
+ ***************************************************************************/
+
+
+#define SEISCOMP_TEST_MODULE test_autoloc_pickpool
+#include <seiscomp/unittest/unittests.h>
+
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include <seiscomp/datamodel/pick.h>
+#include <seiscomp/autoloc/datamodel.h>
+
+
+using namespace Seiscomp::Autoloc;
+using DataModel::PickPool;
+
+
+namespace {
+
+
+const size_t pickCount = 100000;
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Picks with IDs like those of scautopick, e.g.
+// 20220727.004515.26-AIC-IU.TATO.00.BHZ, in random order.
+std::vector<DataModel::PickCPtr> createPicks(size_t count, unsigned seed)
+{
+	// The SC picks are not looked up by ID
+	Seiscomp::DataModel::PublicObject::SetRegistrationEnabled(false);
+
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<int> letter('A', 'Z');
+	std::uniform_real_distribution<double> offset(0., 86400.);
+
+	std::vector<DataModel::PickCPtr> picks;
+	picks.reserve(count);
+	for (size_t i=0; i<count; i++) {
+		Seiscomp::Core::Time time(1658880000. + offset(random));
+		std::string net{char(letter(random)), char(letter(random))};
+		std::string sta{
+			char(letter(random)), char(letter(random)),
+			char(letter(random)), char(letter(random))};
+
+		char id[64];
+		snprintf(id, sizeof(id), "%s-AIC-%s.%s.00.BHZ",
+			time.toString("%Y%m%d.%H%M%S.%2f").c_str(),
+			net.c_str(), sta.c_str());
+
+		Seiscomp::DataModel::PickPtr scpick =
+			Seiscomp::DataModel::Pick::Create(id);
+		scpick->setTime(Seiscomp::DataModel::TimeQuantity(time));
+		scpick->setWaveformID(
+			Seiscomp::DataModel::WaveformStreamID(
+				net, sta, "00", "BHZ", ""));
+		Seiscomp::DataModel::CreationInfo ci;
+		ci.setCreationTime(time);
+		scpick->setCreationInfo(ci);
+
+		picks.push_back(new DataModel::Pick(scpick.get()));
+	}
+
+	Seiscomp::DataModel::PublicObject::SetRegistrationEnabled(true);
+
+	return picks;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+class Stopwatch {
+	public:
+		Stopwatch() : _start(std::chrono::steady_clock::now()) {}
+
+		// nanoseconds per operation since construction
+		double perOperation(size_t count) const {
+			std::chrono::duration<double, std::nano> elapsed =
+				std::chrono::steady_clock::now() - _start;
+			return elapsed.count()/count;
+		}
+
+	private:
+		std::chrono::steady_clock::time_point _start;
+};
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+}
+
+
+BOOST_AUTO_TEST_SUITE(seiscomp_autoloc_pickpool)
+
+
+BOOST_AUTO_TEST_CASE(stableHandles) {
+	std::vector<DataModel::PickCPtr> picks = createPicks(pickCount, 1);
+
+	// The table grows several times while inserting. The handles
+	// must not change.
+	PickPool pool;
+	std::vector<PickPool::Handle> handles;
+	for (const DataModel::PickCPtr &pick : picks)
+		handles.push_back(pool.insert(pick.get()));
+	BOOST_REQUIRE_EQUAL(pool.size(), picks.size());
+	for (size_t i=0; i<picks.size(); i++) {
+		BOOST_CHECK_EQUAL(pool.find(picks[i]->id()), handles[i]);
+		BOOST_CHECK_EQUAL(picks[i]->poolHandle(), handles[i]);
+		BOOST_CHECK(pool.get(handles[i]) == picks[i].get());
+	}
+
+	// inserting again returns the same handle
+	for (size_t i=0; i<picks.size(); i+=97)
+		BOOST_CHECK_EQUAL(pool.insert(picks[i].get()), handles[i]);
+
+	for (size_t i=0; i<picks.size(); i+=2)
+		BOOST_CHECK(pool.erase(handles[i]));
+	BOOST_CHECK_EQUAL(pool.size(), picks.size()/2);
+
+	// iteration in order of the pick IDs
+	std::string previous;
+	size_t count = 0;
+	for (const DataModel::PickCPtr &pick : pool) {
+		BOOST_CHECK(previous < pick->id());
+		previous = pick->id();
+		count++;
+	}
+	BOOST_CHECK_EQUAL(count, pool.size());
+
+	// The erased handles are reused, so the handles stay dense.
+	// Inserting rehashes the table to get rid of the Deleted slots.
+	std::vector<DataModel::PickCPtr> more = createPicks(pickCount/2, 2);
+	for (const DataModel::PickCPtr &pick : more)
+		BOOST_CHECK(pool.insert(pick.get()) < pickCount);
+	BOOST_CHECK_EQUAL(pool.size(), pickCount);
+
+	for (size_t i=0; i<picks.size(); i++) {
+		if (i % 2) {
+			BOOST_CHECK_EQUAL(pool.find(picks[i]->id()), handles[i]);
+			BOOST_CHECK(pool.get(handles[i]) == picks[i].get());
+		}
+		else
+			BOOST_CHECK_EQUAL(
+				pool.find(picks[i]->id()), PickPool::InvalidHandle);
+	}
+
+	// Once all picks are erased, the handles are reused even
+	// without iterating.
+	for (const DataModel::PickCPtr &pick : more)
+		BOOST_CHECK(pool.erase(pool.find(pick->id())));
+	for (size_t i=1; i<picks.size(); i+=2)
+		BOOST_CHECK(pool.erase(handles[i]));
+	BOOST_CHECK_EQUAL(pool.size(), 0);
+	for (const DataModel::PickCPtr &pick : picks)
+		BOOST_CHECK(pool.insert(pick.get()) < pickCount);
+	BOOST_CHECK_EQUAL(pool.size(), pickCount);
+}
+
+
+BOOST_AUTO_TEST_CASE(benchmark) {
+	std::vector<DataModel::PickCPtr> picks = createPicks(pickCount, 3);
+
+	// The previous pool for comparison
+	std::map<std::string, DataModel::PickCPtr> map;
+	PickPool pool;
+	std::vector<PickPool::Handle> handles;
+	handles.reserve(picks.size());
+
+	Stopwatch mapInsert;
+	for (const DataModel::PickCPtr &pick : picks)
+		map[pick->id()] = pick;
+	double mapInsertTime = mapInsert.perOperation(picks.size());
+
+	Stopwatch poolInsert;
+	for (const DataModel::PickCPtr &pick : picks)
+		handles.push_back(pool.insert(pick.get()));
+	double poolInsertTime = poolInsert.perOperation(picks.size());
+
+	size_t found = 0;
+	Stopwatch mapFind;
+	for (const DataModel::PickCPtr &pick : picks)
+		found += map.find(pick->id()) != map.end();
+	double mapFindTime = mapFind.perOperation(picks.size());
+	BOOST_CHECK_EQUAL(found, picks.size());
+
+	found = 0;
+	Stopwatch poolFind;
+	for (const DataModel::PickCPtr &pick : picks)
+		found += pool.get(pick->id()) != nullptr;
+	double poolFindTime = poolFind.perOperation(picks.size());
+	BOOST_CHECK_EQUAL(found, picks.size());
+
+	Stopwatch mapErase;
+	for (const DataModel::PickCPtr &pick : picks)
+		map.erase(pick->id());
+	double mapEraseTime = mapErase.perOperation(picks.size());
+
+	Stopwatch poolErase;
+	for (PickPool::Handle handle : handles)
+		pool.erase(handle);
+	double poolEraseTime = poolErase.perOperation(picks.size());
+	BOOST_CHECK_EQUAL(pool.size(), 0);
+
+	BOOST_TEST_MESSAGE("pick pool with " << picks.size() << " picks, ns per pick");
+	BOOST_TEST_MESSAGE("  insert  map " << mapInsertTime << "  pool " << poolInsertTime);
+	BOOST_TEST_MESSAGE("  lookup  map " << mapFindTime   << "  pool " << poolFindTime);
+	BOOST_TEST_MESSAGE("  erase   map " << mapEraseTime  << "  pool " << poolEraseTime);
+}
+
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -54,6 +54,35 @@ def test_config():
 
     assert c.adoptManualDepth == False
 
+    assert c.cleanupStepSize == 100
+    assert c.scPickKeep == 0
+    assert c.associatorThreads == 1
+    assert c.locatorPoolSize == 1
+    assert c.relocationCacheSize == 1000
+    assert c.secondPassMaxShift == 0
+    assert c.secondPassMaxTimeShift == 0
+    assert c.secondPassMaxRMSChange == 0
+    assert c.enhanceScoreMaxTrials == 5
+    assert c.enhanceScoreTimeBudget == 0
+    assert len(c.depthScanDepths) == 0
+    assert c.preLocatorMaxRMS == 0
+    assert c.mergeEnable == False
+    assert c.mergeMaxTimeDiff == 20
+    assert c.mergeMaxDist == 1
+    assert c.batchMaxDelay == 0
+    assert c.batchMaxSize == 100
+    assert c.batchMinRate == 20
+    assert c.passiveManualOrigins == False
+
+    c.depthScanDepths.append(10.)
+    c.depthScanDepths.append(100.)
+    assert [d for d in c.depthScanDepths] == [10., 100.]
+
+    c.associatorThreads = 4
+    c.batchMaxDelay = 0.5
+    c.mergeEnable = True
+    assert (c.associatorThreads, c.batchMaxDelay, c.mergeEnable) == (4, 0.5, True)
+
 
 def test_stationLocationFile():
     s = """
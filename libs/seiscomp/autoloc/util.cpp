@@ -309,9 +309,13 @@ std::string printOrigin(
 
 		out.setf(std::ios::right);
 
+		std::vector<ArrivalScore> arrivalScores;
+		double score = originScore(origin, 3.5, 0., &arrivalScores);
+
 		int arrivalCount = origin->arrivals.size();
 		for(int i=0; i<arrivalCount; i++) {
 			const Autoloc::DataModel::Arrival &arr = origin->arrivals[i];
+			const ArrivalScore &arrivalScore = arrivalScores[i];
 			const Autoloc::DataModel::Pick* pick = arr.pick.get();
 
 			if ( ! pick->station()) {
@@ -344,10 +348,10 @@ std::string printOrigin(
 //			out.precision(1);
 //			out	<< "  " << std::right << std::fixed << std::setw(8) << arr.pick->snr;;
 			out.precision(2);
-			out	<< ' ' << arr.score << " -";
-			out	<< ' ' << arr.tscore;
-			out	<< ' ' << arr.ascore;
-			out	<< ' ' << arr.dscore;
+			out	<< ' ' << arrivalScore.score << " -";
+			out	<< ' ' << arrivalScore.tscore;
+			out	<< ' ' << arrivalScore.ascore;
+			out	<< ' ' << arrivalScore.dscore;
 			out	<< ' ' << pick->id();
 			out	<< std::endl;
 		}
@@ -358,7 +362,7 @@ std::string printOrigin(
 		out << "MD    = " << meandev(origin) << std::endl;
 		out << "PGAP  = " << origin->quality.aziGapPrimary << std::endl;
 		out << "SGAP  = " << origin->quality.aziGapSecondary << std::endl;
-		out << "SCORE = " << originScore(origin) << std::endl;
+		out << "SCORE = " << score << std::endl;
 		out << "preliminary = "  << (origin->preliminary ? "true":"false") << std::endl;
 		out << "locked = "  << (origin->locked ? "true" : "false") << std::endl;
 
@@ -442,23 +446,31 @@ static double avgfn2(double x, double plateauWidth=0.2)
 double originScore(
 	const Autoloc::DataModel::Origin *origin,
 	double maxRMS,
-	double networkSizeKm)
+	double networkSizeKm,
+	std::vector<ArrivalScore> *arrivalScores)
 {
-	// FIXME:
-	((Autoloc::DataModel::Origin*)origin)->arrivals.sort();
+	if (arrivalScores) {
+		arrivalScores->clear();
+		arrivalScores->resize(origin->arrivals.size());
+	}
+
+	// The arrivals are visited in order of distance, which matters
+	// for the amplitude score limit below. The order is cached with
+	// the arrivals, so neither are the arrivals sorted here nor is
+	// anything allocated unless the arrivals have changed.
+	std::shared_ptr<const Autoloc::DataModel::ArrivalVector::Order>
+		order = origin->arrivals.sortedOrder();
 
 	double score = 0, amplScoreMax=0;
-	int arrivalCount = origin->arrivals.size();
+	int arrivalCount = order->size();
 	for(int i=0; i<arrivalCount; i++) {
 		double phaseScore = 1; // 1 for P / 0.3 for PKP
-		Autoloc::DataModel::Arrival &arr =
-			((Autoloc::DataModel::Origin*)origin)->arrivals[i];
-		Autoloc::DataModel::PickCPtr pick = arr.pick;
+		const Autoloc::DataModel::Arrival &arr =
+			origin->arrivals[(*order)[i]];
+		const Autoloc::DataModel::Pick *pick = arr.pick.get();
 		if ( ! pick->station())
 			continue;
 
-		arr.score = 0;
-		arr.ascore = arr.dscore = arr.tscore = 0;
 		// higher score for picks with higher SNR
 		double snr = pick->snr > 3 ? pick->snr : 3;
 		if ( snr > 1.E07 )
@@ -472,12 +484,12 @@ double originScore(
 		// pronounced onset so setting the missing SNR of a confirmed
 		// manual pick allows to increase the origin score due to this
 		// pick.
-		if (manual(pick.get()) && ! pick->scamplSNR)
+		if (manual(pick) && ! pick->hasAmplitudeSNR)
 			snr = 10; // make this configurable
 		// TODO: set this as early as possible
 
 		double normamp = pick->normamp;
-		if (manual(pick.get()) && normamp <= 0)
+		if (manual(pick) && normamp <= 0)
 			normamp = 1; // make this configurable
 
 		double snrScore = log10(snr);
@@ -532,9 +544,13 @@ double originScore(
 
 		double timeScore = avgfn2(arr.residual/(2*maxRMS));
 
-		arr.dscore = distScore;
-		arr.ascore = amplScore;
-		arr.tscore = timeScore;
+		ArrivalScore *terms = arrivalScores
+			? &(*arrivalScores)[(*order)[i]] : nullptr;
+		if (terms) {
+			terms->dscore = distScore;
+			terms->ascore = amplScore;
+			terms->tscore = timeScore;
+		}
 
 		if (arr.excluded) {
 			if (arr.excluded !=
@@ -545,9 +561,13 @@ double originScore(
 			phaseScore = 0.3;
 		}
 
-//		arr.score = phaseScore*weight*timeScore;
-		arr.score = phaseScore*timeScore*distScore*amplScore;
-		score += arr.score;
+//		arrivalScore = phaseScore*weight*timeScore;
+		// Rounded to float like the score stored with the arrival,
+		// which is what used to be summed up
+		float arrivalScore = phaseScore*timeScore*distScore*amplScore;
+		if (terms)
+			terms->score = arrivalScore;
+		score += arrivalScore;
 
 		// higher score for picks not excluded from location
 //		score += arr.excluded ? 0 : 0.3;
@@ -578,6 +598,41 @@ double originScore(
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double updateArrivalScores(
+	Autoloc::DataModel::Origin *origin,
+	double maxRMS,
+	double networkSizeKm)
+{
+	std::vector<ArrivalScore> arrivalScores;
+	double score = originScore(
+		origin, maxRMS, networkSizeKm, &arrivalScores);
+
+	// Unchanged scores are not written, as any write access would
+	// copy arrivals shared with other origins.
+	const Autoloc::DataModel::ArrivalVector &arrivals = origin->arrivals;
+	for (size_t i=0; i<arrivals.size(); i++) {
+		const ArrivalScore &terms = arrivalScores[i];
+		const Autoloc::DataModel::Arrival &arr = arrivals[i];
+		if (arr.score == terms.score && arr.dscore == terms.dscore &&
+		    arr.ascore == terms.ascore && arr.tscore == terms.tscore)
+			continue;
+
+		Autoloc::DataModel::Arrival a = arr;
+		a.score = terms.score;
+		a.dscore = terms.dscore;
+		a.ascore = terms.ascore;
+		a.tscore = terms.tscore;
+		origin->arrivals.set(i, a);
+	}
+
+	return score;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool determineAzimuthalGaps(const Autoloc::DataModel::Origin *origin, double *primary, double *secondary)
 {
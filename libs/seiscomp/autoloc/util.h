@@ -46,9 +46,24 @@ void delazi(
 	const Autoloc::DataModel::Station*,
 	double &delta, double &az1, double &az2);
 
-// Compute the origin score. The higher the better.
+// The score contributed by one arrival and its terms
+class ArrivalScore {
+	public:
+		float score{0}, dscore{0}, ascore{0}, tscore{0};
+};
+
+// Compute the origin score. The higher the better. The origin is not
+// modified. If arrivalScores is given, it receives the score of each
+// arrival, in the order of the arrivals.
 double originScore(
 	const Autoloc::DataModel::Origin *origin,
+	double maxRMS=3.5, double radius=0.,
+	std::vector<ArrivalScore> *arrivalScores=nullptr);
+
+// Compute the origin score like originScore() and store the score of
+// each arrival with the arrival.
+double updateArrivalScores(
+	Autoloc::DataModel::Origin *origin,
 	double maxRMS=3.5, double radius=0.);
 
 // Compute primary and secondary azimuthal gaps for the given origin
@@ -28,6 +28,7 @@
 
 namespace std {
     %template(StringVector)  vector<string>;
+    %template(DoubleVector)  vector<double>;
 }
 
 %import  "base.i"